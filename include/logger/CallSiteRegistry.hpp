@@ -0,0 +1,288 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "logger/Message.hpp"
+
+namespace logger
+{
+
+/** Runtime switches of single log statements (call sites made by LOGGER_CALL_CONTEXT).
+ *
+ * An enabled site is logged whatever the logger's filteringLevel, a disabled one never.
+ * Patterns have the form "<file>[:<line>][#<function>]" with * and ? wildcards:
+ *   "session.cpp:120"           one statement
+ *   "net_*.cpp"                 every statement in the matching files
+ *   "*#Session::read"           every statement in the function
+ *   "*#*::read"                 every statement in the functions `read` of all classes and namespaces
+ * A file pattern matches the whole __FILE__ or any part of it following a '/'. A function pattern
+ * matches the qualified name, without the return and parameter types, taken from the decorated
+ * function (__PRETTY_FUNCTION__, __FUNCSIG__); with gcc, statements in a lambda match its enclosing
+ * function, the names of lambdas of other compilers differ.
+ * Rules are kept, so sites executed for the first time later follow them too; the last matching
+ * rule wins. Process wide and never destroyed.
+ */
+class CallSiteRegistry
+{
+public:
+  struct SiteInfo
+  {
+    std::string file;
+    unsigned int line;
+    std::string function; // qualified name
+    std::uint8_t state;
+  };
+
+  static CallSiteRegistry& instance()
+  {
+    static CallSiteRegistry* registry = new CallSiteRegistry();
+    return *registry;
+  }
+
+  void enable(const std::string& pattern)
+  {
+    addRule(pattern, details::CallSite::ENABLED);
+  }
+
+  void disable(const std::string& pattern)
+  {
+    addRule(pattern, details::CallSite::DISABLED);
+  }
+
+  /* back to the logger's filteringLevel */
+  void reset(const std::string& pattern)
+  {
+    addRule(pattern, details::CallSite::DEFAULT);
+  }
+
+  /* removes all rules */
+  void clear()
+  {
+    std::lock_guard< std::mutex > lock(mt);
+    rules.clear();
+    for (auto site = sites; site; site = site->next)
+    {
+      site->state.store(details::CallSite::DEFAULT, std::memory_order_relaxed);
+    }
+  }
+
+  /* sites executed so far */
+  std::vector< SiteInfo > getSites() const
+  {
+    std::vector< SiteInfo > result;
+    std::lock_guard< std::mutex > lock(mt);
+    for (auto site = sites; site; site = site->next)
+    {
+      result.push_back(SiteInfo{ site->file, site->line, qualifiedName(site->function), site->state.load(std::memory_order_relaxed) });
+    }
+    return result;
+  }
+
+  /* called by Logger on the first execution of a site, returns its state */
+  std::uint8_t add(details::CallSite& site, const CallContext& context)
+  {
+    std::lock_guard< std::mutex > lock(mt);
+    if (site.state.load(std::memory_order_relaxed) == details::CallSite::UNREGISTERED)
+    {
+      site.function = context.decoratedFunction ? context.decoratedFunction : context.function;
+      site.file = context.file;
+      site.line = context.line;
+      site.next = sites;
+      sites = &site;
+
+      auto state = details::CallSite::DEFAULT;
+      for (const auto& rule : rules)
+      {
+        if (rule.matches(site))
+        {
+          state = rule.state;
+        }
+      }
+      site.state.store(state, std::memory_order_relaxed);
+    }
+    return site.state.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Rule
+  {
+    std::string file;
+    unsigned int line; // 0 - any
+    std::string function;
+    std::uint8_t state;
+
+    bool matches(const details::CallSite& site) const
+    {
+      return (line == 0 || line == site.line)
+        && (function.empty() || wildcardMatch(function.c_str(), qualifiedName(site.function).c_str()))
+        && matchesFile(site.file);
+    }
+
+    bool matchesFile(const char* path) const
+    {
+      if (file.empty() || wildcardMatch(file.c_str(), path))
+      {
+        return true;
+      }
+      for (const char* slash = path; *slash; ++slash)
+      {
+        if ((*slash == '/' || *slash == '\\') && wildcardMatch(file.c_str(), slash + 1))
+        {
+          return true;
+        }
+      }
+      return false;
+    }
+  };
+
+  mutable std::mutex mt; // guards rules and sites
+  std::vector< Rule > rules;
+  details::CallSite* sites; // registered sites, linked by CallSite::next
+
+  CallSiteRegistry()
+    :
+    sites(nullptr)
+  {
+  }
+
+  void addRule(const std::string& pattern, std::uint8_t state)
+  {
+    Rule rule = parse(pattern);
+    rule.state = state;
+
+    std::lock_guard< std::mutex > lock(mt);
+    rules.push_back(rule);
+    for (auto site = sites; site; site = site->next)
+    {
+      if (rule.matches(*site))
+      {
+        site->state.store(state, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  static Rule parse(const std::string& pattern)
+  {
+    Rule rule;
+    rule.line = 0;
+
+    auto location = pattern;
+    const auto hash = pattern.find('#');
+    if (hash != std::string::npos)
+    {
+      rule.function = pattern.substr(hash + 1);
+      location = pattern.substr(0, hash);
+    }
+
+    const auto colon = location.rfind(':');
+    if (colon != std::string::npos && colon + 1 < location.size()
+      && location.find_first_not_of("0123456789", colon + 1) == std::string::npos)
+    {
+      rule.line = static_cast< unsigned int >(std::stoul(location.substr(colon + 1)));
+      location.resize(colon);
+    }
+    rule.file = location == "*" ? std::string() : location;
+    return rule;
+  }
+
+  /* "Session::read" of "void Session::read(int) const", angle brackets and parentheses
+   * (template arguments, "(anonymous namespace)") are kept with their spaces
+   */
+  static std::string qualifiedName(const char* decorated)
+  {
+    std::string text(decorated);
+    const auto with = text.find(" [with "); // template arguments of gcc
+    if (with != std::string::npos)
+    {
+      text.resize(with);
+    }
+    const auto lambda = text.find("::<lambda"); // gcc, after the enclosing function
+    if (lambda != std::string::npos)
+    {
+      text.resize(lambda);
+    }
+
+    const auto close = text.rfind(')');
+    if (close == std::string::npos)
+    {
+      return text; // not decorated
+    }
+    int depth = 0;
+    auto open = close + 1;
+    for (auto i = close + 1; i-- > 0;)
+    {
+      if (text[i] == ')')
+      {
+        ++depth;
+      }
+      else if (text[i] == '(' && --depth == 0)
+      {
+        open = i; // of the parameter list
+        break;
+      }
+    }
+    if (open > close)
+    {
+      return text;
+    }
+
+    depth = 0;
+    auto begin = open;
+    for (; begin > 0; --begin)
+    {
+      const char c = text[begin - 1];
+      if (c == '>' || c == ')')
+      {
+        ++depth;
+      }
+      else if ((c == '<' || c == '(') && depth > 0)
+      {
+        --depth;
+      }
+      else if (c == ' ' && depth == 0)
+      {
+        break; // after the return type or the calling convention
+      }
+    }
+    return text.substr(begin, open - begin);
+  }
+
+  /* * matches any sequence, ? any single character */
+  static bool wildcardMatch(const char* pattern, const char* text)
+  {
+    const char* star = nullptr;
+    const char* resume = nullptr;
+    while (*text)
+    {
+      if (*pattern == '*')
+      {
+        star = pattern++;
+        resume = text;
+      }
+      else if (*pattern == '?' || *pattern == *text)
+      {
+        ++pattern;
+        ++text;
+      }
+      else if (star)
+      {
+        pattern = star + 1;
+        text = ++resume;
+      }
+      else
+      {
+        return false;
+      }
+    }
+    while (*pattern == '*')
+    {
+      ++pattern;
+    }
+    return !*pattern;
+  }
+};
+
+} // logger
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+namespace logger
+{
+
+/** Outcome of a durable message (Logger::logDurable), completed by the sink which wrote it.
+ */
+class CommitHandle
+{
+public:
+  enum class State
+  {
+    PENDING,
+    DURABLE,       // on stable storage (fdatasync returned)
+    FAILED,        // written, but the write or the sync failed
+    NOT_SUPPORTED, // consumed by a sink without durability support
+    FILTERED       // not logged: level, call site or rate limit
+  };
+
+  CommitHandle()
+    :
+    state(State::PENDING)
+  {
+  }
+
+  State getState() const
+  {
+    std::lock_guard< std::mutex > lock(mt);
+    return state;
+  }
+
+  State wait() const
+  {
+    std::unique_lock< std::mutex > lock(mt);
+    completed.wait(lock, [this]() { return state != State::PENDING; });
+    return state;
+  }
+
+  /* State::PENDING on timeout */
+  template< typename Rep, typename Period >
+  State waitFor(const std::chrono::duration< Rep, Period >& timeout) const
+  {
+    std::unique_lock< std::mutex > lock(mt);
+    completed.wait_for(lock, timeout, [this]() { return state != State::PENDING; });
+    return state;
+  }
+
+  void complete(State result)
+  {
+    {
+      std::lock_guard< std::mutex > lock(mt);
+      state = result;
+    }
+    completed.notify_all();
+  }
+
+private:
+  mutable std::mutex mt;
+  mutable std::condition_variable completed;
+  State state;
+};
+
+/** Travels with a durable Message. A sink supporting durability takes the handle with release()
+ * and completes it after the sync; if the message is destroyed with the ticket still attached,
+ * the waiter is released with State::NOT_SUPPORTED instead of waiting forever.
+ */
+class CommitTicket
+{
+public:
+  CommitTicket() = default;
+
+  explicit CommitTicket(std::shared_ptr< CommitHandle > aHandle)
+    :
+    handle(std::move(aHandle))
+  {
+  }
+
+  CommitTicket(CommitTicket&& other) = default;
+
+  CommitTicket& operator=(CommitTicket&& other)
+  {
+    if (this != &other)
+    {
+      abandon();
+      handle = std::move(other.handle);
+    }
+    return *this;
+  }
+
+  ~CommitTicket()
+  {
+    abandon();
+  }
+
+  explicit operator bool() const
+  {
+    return static_cast< bool >(handle);
+  }
+
+  std::shared_ptr< CommitHandle > release()
+  {
+    return std::move(handle);
+  }
+
+private:
+  std::shared_ptr< CommitHandle > handle;
+
+  void abandon()
+  {
+    if (handle)
+    {
+      handle->complete(CommitHandle::State::NOT_SUPPORTED);
+      handle.reset();
+    }
+  }
+};
+
+} // logger
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+
+#include "logger/Message.hpp"
+#include "logger/StringHelpers.hpp"
+#include "logger/StructuredFields.hpp"
+
+namespace logger
+{
+
+namespace details
+{
+
+/* JSON string escaping, 8 bytes at a time:
+ * words without '"', '\\' or control characters are copied as a whole,
+ * only words containing such a byte are escaped byte by byte.
+ * Bytes >= 0x80 (UTF-8 sequences) are copied unchanged.
+ */
+inline void appendJsonEscaped(std::string& out, const char* text, std::size_t size)
+{
+  static const char HEX[] = "0123456789abcdef";
+  const std::uint64_t ONES = 0x0101010101010101ull;
+  const std::uint64_t HIGHS = 0x8080808080808080ull;
+
+  auto needsEscaping = [&](std::uint64_t word)
+  {
+    auto hasZero = [&](std::uint64_t value) { return (value - ONES) & ~value & HIGHS; };
+    const std::uint64_t controls = (word - ONES * 0x20) & ~word & HIGHS;
+    return (controls | hasZero(word ^ (ONES * '"')) | hasZero(word ^ (ONES * '\\'))) != 0;
+  };
+
+  auto escape = [&](char c)
+  {
+    switch (c)
+    {
+    case '"': out += "\\\""; break;
+    case '\\': out += "\\\\"; break;
+    case '\n': out += "\\n"; break;
+    case '\r': out += "\\r"; break;
+    case '\t': out += "\\t"; break;
+    default:
+      if (static_cast< unsigned char >(c) < 0x20)
+      {
+        const char sequence[] = { '\\', 'u', '0', '0', HEX[(c >> 4) & 0xf], HEX[c & 0xf] };
+        out.append(sequence, sizeof(sequence));
+      }
+      else
+      {
+        out.push_back(c);
+      }
+    }
+  };
+
+  std::size_t clean = 0; // start of the pending run of bytes which need no escaping
+  std::size_t i = 0;
+  for (; i + sizeof(std::uint64_t) <= size; i += sizeof(std::uint64_t))
+  {
+    std::uint64_t word;
+    std::memcpy(&word, text + i, sizeof(word));
+    if (!needsEscaping(word))
+    {
+      continue;
+    }
+
+    out.append(text + clean, i - clean);
+    for (std::size_t j = i; j < i + sizeof(std::uint64_t); ++j)
+    {
+      escape(text[j]);
+    }
+    clean = i + sizeof(std::uint64_t);
+  }
+
+  out.append(text + clean, i - clean);
+  for (; i < size; ++i)
+  {
+    escape(text[i]);
+  }
+}
+
+inline void appendJsonString(std::string& out, const char* text, std::size_t size)
+{
+  out.push_back('"');
+  appendJsonEscaped(out, text, size);
+  out.push_back('"');
+}
+
+/* integer to text without locale or stream overhead */
+inline void appendUnsigned(std::string& out, std::uint64_t value)
+{
+  char buffer[20];
+  char* end = buffer + sizeof(buffer);
+  char* begin = end;
+  do
+  {
+    *--begin = static_cast< char >('0' + value % 10);
+    value /= 10;
+  } while (value);
+  out.append(begin, end - begin);
+}
+
+inline void appendSigned(std::string& out, std::int64_t value)
+{
+  if (value < 0)
+  {
+    out.push_back('-');
+    appendUnsigned(out, 0 - static_cast< std::uint64_t >(value));
+    return;
+  }
+  appendUnsigned(out, static_cast< std::uint64_t >(value));
+}
+
+inline void appendDouble(std::string& out, double value)
+{
+  if (!std::isfinite(value))
+  {
+    out += "null"; // not representable in JSON
+    return;
+  }
+  char buffer[32];
+  const int size = std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+  out.append(buffer, size);
+}
+
+} // details
+
+/* Formats messages as JSON lines:
+ * {"time":<ns since epoch>,"level":"INFO","logger":"...","thread":<id hash>,"file":"...","line":1,
+ *  "function":"...","message":"...",<structured fields>}
+ */
+class JsonFormatter
+{
+public:
+  std::string operator()(const Message& message) const
+  {
+    std::string out;
+    out.reserve(128 + message.content.size() + message.fields.size() * 2);
+
+    out += "{\"time\":";
+    details::appendSigned(out, std::chrono::duration_cast< std::chrono::nanoseconds >(message.time.time_since_epoch()).count());
+    out += ",\"level\":\"";
+    out += toString(message.level);
+    out += "\",\"logger\":";
+    const auto& loggerName = message.loggerContext->name;
+    details::appendJsonString(out, loggerName.data(), loggerName.size());
+    out += ",\"thread\":";
+    details::appendUnsigned(out, std::hash< std::thread::id >()(message.threadId));
+    out += ",\"file\":";
+    details::appendJsonString(out, message.callContext.file, std::strlen(message.callContext.file));
+    out += ",\"line\":";
+    details::appendUnsigned(out, message.callContext.line);
+    out += ",\"function\":";
+    details::appendJsonString(out, message.callContext.function, std::strlen(message.callContext.function));
+    out += ",\"message\":";
+    details::appendJsonString(out, message.content.data(), message.content.size());
+
+    FieldReader reader(message.fields);
+    FieldView field;
+    while (reader.next(field))
+    {
+      out.push_back(',');
+      details::appendJsonString(out, field.key, field.keySize);
+      out.push_back(':');
+      appendValue(out, field);
+    }
+
+    out += "}\n";
+    return out;
+  }
+
+private:
+  static void appendValue(std::string& out, const FieldView& field)
+  {
+    switch (field.type)
+    {
+    case FieldType::INT:
+      details::appendSigned(out, field.intValue);
+      break;
+    case FieldType::UINT:
+      details::appendUnsigned(out, field.uintValue);
+      break;
+    case FieldType::DOUBLE:
+      details::appendDouble(out, field.doubleValue);
+      break;
+    case FieldType::BOOL:
+      out += field.boolValue ? "true" : "false";
+      break;
+    case FieldType::STRING:
+      details::appendJsonString(out, field.text, field.textSize);
+      break;
+    }
+  }
+};
+
+} // logger
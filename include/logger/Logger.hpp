@@ -1,10 +1,33 @@
 #pragma once
 
+#include <algorithm>
+#include <mutex>
+
 #include "logger/Sink.hpp"
+#include "logger/RateLimiter.hpp"
+#include "logger/StructuredFields.hpp"
+#include "logger/VolumeProfiler.hpp"
+#include "logger/CallSiteRegistry.hpp"
+
+#include "logger/details/Epoch.hpp"
 
 namespace logger
 {
 
+/* Everything a Logger reads when logging, replaced as a whole */
+struct LoggerConfig
+{
+  std::shared_ptr< Sink > sink;
+  Level filteringLevel = Level::NEVER;
+  Level autoFlushLevel = Level::NEVER;
+  std::shared_ptr< RateLimiter > rateLimiter; // optional, nullptr - no limits
+};
+
+/* The configuration may be changed at any time while other threads log:
+ * logging reads an immutable LoggerConfig snapshot inside an epoch critical section
+ * (no lock, no reference counting), configure() publishes a new snapshot and retires the old
+ * one, which is deleted, together with its references to sinks, when no thread can use it anymore.
+ */
 class Logger
 {
 public:
@@ -13,15 +36,121 @@ public:
   explicit Logger(const std::string& name)
     :
     loggerContext(std::make_shared< LoggerContext >(name)),
+    config(makeDefaultConfig()),
     filteringLevel(Level::NEVER),
-    autoFlushLevel(Level::NEVER),
-    sink(std::make_shared< NullSink >())
+    configuredLevel(Level::NEVER),
+    overloadLevel(Level::TRACE),
+    shed(0),
+    shedAtDegrade(0),
+    nextSuppressedCheck(0)
   {
   }
 
-  std::atomic< Level > filteringLevel;
-  std::atomic< Level > autoFlushLevel;
-  std::shared_ptr< Sink > sink;
+  ~Logger()
+  {
+    delete config.load();
+  }
+
+  Logger(const Logger&) = delete;
+  Logger& operator=(const Logger&) = delete;
+
+  /* copy of the current configuration */
+  LoggerConfig getConfig() const
+  {
+    details::EpochGuard guard;
+    return *config.load(std::memory_order_acquire);
+  }
+
+  /* read-modify-write of the configuration, concurrent calls are serialized */
+  void configure(const std::function< void(LoggerConfig&) >& update)
+  {
+    std::lock_guard< std::mutex > lock(configMt);
+    std::unique_ptr< LoggerConfig > updated(new LoggerConfig(*config.load(std::memory_order_relaxed)));
+    update(*updated);
+    if (!updated->sink)
+    {
+      updated->sink = std::make_shared< NullSink >();
+    }
+
+    configuredLevel.store(updated->filteringLevel, std::memory_order_relaxed);
+    updateFilteringLevel();
+    auto previous = config.exchange(updated.release());
+    details::EpochDomain::instance().retire(previous);
+  }
+
+  void setConfig(const LoggerConfig& newConfig)
+  {
+    configure([&newConfig](LoggerConfig& current) { current = newConfig; });
+  }
+
+  void setSink(std::shared_ptr< Sink > sink)
+  {
+    configure([&sink](LoggerConfig& current) { current.sink = std::move(sink); });
+  }
+
+  std::shared_ptr< Sink > getSink() const
+  {
+    details::EpochGuard guard;
+    return config.load(std::memory_order_acquire)->sink;
+  }
+
+  void setLevel(Level level)
+  {
+    configure([level](LoggerConfig& current) { current.filteringLevel = level; });
+  }
+
+  /* the configured level, see getEffectiveLevel() */
+  Level getLevel() const
+  {
+    return configuredLevel.load(std::memory_order_relaxed);
+  }
+
+  /* the configured level, raised while degraded */
+  Level getEffectiveLevel() const
+  {
+    return filteringLevel.load(std::memory_order_relaxed);
+  }
+
+  /* Overload degradation (see OverloadController): until restore(), messages below `level` are
+   * dropped whatever the configured level and counted as shed. Enabled call sites still pass.
+   */
+  void degrade(Level level)
+  {
+    std::lock_guard< std::mutex > lock(configMt);
+    shedAtDegrade = shed.load(std::memory_order_relaxed);
+    overloadLevel.store(level, std::memory_order_relaxed);
+    updateFilteringLevel();
+  }
+
+  /* returns the number of messages shed since degrade() */
+  std::uint64_t restore()
+  {
+    std::lock_guard< std::mutex > lock(configMt);
+    overloadLevel.store(Level::TRACE, std::memory_order_relaxed);
+    updateFilteringLevel();
+    return shed.load(std::memory_order_relaxed) - shedAtDegrade;
+  }
+
+  bool isDegraded() const
+  {
+    return overloadLevel.load(std::memory_order_relaxed) != Level::TRACE;
+  }
+
+  /* messages shed since the logger was created */
+  std::uint64_t getShedCount() const
+  {
+    return shed.load(std::memory_order_relaxed);
+  }
+
+  void setAutoFlushLevel(Level level)
+  {
+    configure([level](LoggerConfig& current) { current.autoFlushLevel = level; });
+  }
+
+  void setRateLimiter(std::shared_ptr< RateLimiter > rateLimiter)
+  {
+    configure([&rateLimiter](LoggerConfig& current) { current.rateLimiter = std::move(rateLimiter); });
+  }
 
   /* Simple versions */
   void critical(const CallContext& aContext, std::string&& message)
@@ -34,11 +163,73 @@ public:
     return log(aContext, Level::ERROR, std::move(message));
   }
 
+  void warning(const CallContext& context, std::string&& message)
+  {
+    return log(context, Level::WARNING, std::move(message));
+  }
+
+  void info(const CallContext& context, std::string&& message)
+  {
+    return log(context, Level::INFO, std::move(message));
+  }
+
   void debug(const CallContext& context, std::string&& message)
   {
     return log(context, Level::DEBUG, std::move(message));
   }
 
+  /* Structured versions, e.g. info(context, "order filled", kv("id", id), kv("px", px)) */
+  template< typename Field, typename... Fields >
+  void critical(const CallContext& context, std::string&& message, const KeyValue< Field >& field, const KeyValue< Fields >&... fields)
+  {
+    return log(context, Level::CRITICAL, std::move(message), field, fields...);
+  }
+
+  template< typename Field, typename... Fields >
+  void error(const CallContext& context, std::string&& message, const KeyValue< Field >& field, const KeyValue< Fields >&... fields)
+  {
+    return log(context, Level::ERROR, std::move(message), field, fields...);
+  }
+
+  template< typename Field, typename... Fields >
+  void warning(const CallContext& context, std::string&& message, const KeyValue< Field >& field, const KeyValue< Fields >&... fields)
+  {
+    return log(context, Level::WARNING, std::move(message), field, fields...);
+  }
+
+  template< typename Field, typename... Fields >
+  void info(const CallContext& context, std::string&& message, const KeyValue< Field >& field, const KeyValue< Fields >&... fields)
+  {
+    return log(context, Level::INFO, std::move(message), field, fields...);
+  }
+
+  template< typename Field, typename... Fields >
+  void debug(const CallContext& context, std::string&& message, const KeyValue< Field >& field, const KeyValue< Fields >&... fields)
+  {
+    return log(context, Level::DEBUG, std::move(message), field, fields...);
+  }
+
+  /* Durable version: the message is synced to the disk by a file sink in a group commit,
+   * wait() on the returned handle blocks until then (see CommitHandle for the outcomes)
+   */
+  std::shared_ptr< CommitHandle > logDurable(const CallContext& context, Level level, std::string&& content)
+  {
+    auto handle = std::make_shared< CommitHandle >();
+    bool sent = false;
+    dispatch(context, level, [&](Message& message, details::SiteCounters*)
+    {
+      message.content = std::move(content);
+      message.commit = CommitTicket(handle);
+      sent = true;
+    }
+    );
+    if (!sent)
+    {
+      handle->complete(CommitHandle::State::FILTERED);
+    }
+    return handle;
+  }
+
   /* Lazy Message Formation versions */
   void debug(const CallContext& context, MakeMessageCallback messgeCallback)
   {
@@ -47,7 +238,13 @@ public:
 
   void flush()
   {
-    sink->flush();
+    details::EpochGuard guard;
+    const auto& current = *config.load(std::memory_order_acquire);
+    if (current.rateLimiter)
+    {
+      reportSuppressed(current);
+    }
+    current.sink->flush();
   }
 
   const std::string& getName() const
@@ -57,47 +254,182 @@ public:
 
 private:
   std::shared_ptr<const LoggerContext> loggerContext;
+  std::atomic< const LoggerConfig* > config; // never nullptr
+  std::atomic< Level > filteringLevel;  // effective level: max of the two below, filtered out messages do not enter the epoch
+  std::atomic< Level > configuredLevel; // copy of config's level
+  std::atomic< Level > overloadLevel;   // Level::TRACE - not degraded
+  std::atomic< std::uint64_t > shed;    // dropped only because of the degradation
+  std::uint64_t shedAtDegrade;          // guarded by configMt
+  std::mutex configMt; // serializes writers of config and overloadLevel
+  std::atomic< RateLimiter::Clock::rep > nextSuppressedCheck; // by flush(), once per summary interval
+
+  /* configMt has to be locked */
+  void updateFilteringLevel()
+  {
+    filteringLevel.store(std::max(configuredLevel.load(std::memory_order_relaxed), overloadLevel.load(std::memory_order_relaxed)),
+      std::memory_order_relaxed);
+  }
 
   void log(const CallContext& context, Level level, std::string&& content)
   {
-    if (level >= filteringLevel)
+    dispatch(context, level, [&content](Message& message, details::SiteCounters*)
     {
-      auto message = makeMessage(context);
-      message->level = level;
-      message->content = std::move(content);
-
-      sink->send(std::move(message));
-      autoFlushIfNeeded(level);
+      message.content = std::move(content);
     }
+    );
   }
 
   void log(const CallContext& context, Level level, MakeMessageCallback messgeCallback)
   {
-    if (level >= filteringLevel)
+    dispatch(context, level, [&messgeCallback](Message& message, details::SiteCounters* site)
+    {
+      if (!site)
+      {
+        message.content = messgeCallback();
+        return;
+      }
+      const auto begin = std::chrono::steady_clock::now();
+      message.content = messgeCallback();
+      site->addCallbackTime(std::chrono::steady_clock::now() - begin);
+    }
+    );
+  }
+
+  template< typename... Fields >
+  void log(const CallContext& context, Level level, std::string&& content, const KeyValue< Fields >&... fields)
+  {
+    dispatch(context, level, [&](Message& message, details::SiteCounters*)
+    {
+      message.content = std::move(content);
+      details::encodeFields(message.fields, fields...);
+    }
+    );
+  }
+
+  /* `fill` sets the content of a message which passed the filters
+   * `site` is the call site's profiling counters, nullptr unless the VolumeProfiler is enabled
+   */
+  template< typename Fill >
+  void dispatch(const CallContext& context, Level level, const Fill& fill)
+  {
+    bool forced = false; // enabled call site
+    if (context.site)
+    {
+      auto state = context.site->state.load(std::memory_order_relaxed);
+      if (state != details::CallSite::DEFAULT)
+      {
+        if (state == details::CallSite::UNREGISTERED)
+        {
+          state = CallSiteRegistry::instance().add(*context.site, context);
+        }
+        if (state == details::CallSite::DISABLED)
+        {
+          return;
+        }
+        forced = state == details::CallSite::ENABLED;
+      }
+    }
+
+    details::SiteCounters* site = nullptr;
+    if (VolumeProfiler::isEnabled())
+    {
+      site = VolumeProfiler::instance().getSite(context);
+      site->addCall();
+    }
+
+    if (level < filteringLevel.load(std::memory_order_relaxed) && !forced)
+    {
+      if (site)
+      {
+        site->addFiltered();
+      }
+      if (level >= configuredLevel.load(std::memory_order_relaxed))
+      {
+        shed.fetch_add(1, std::memory_order_relaxed);
+      }
+      return;
+    }
+
+    details::EpochGuard guard;
+    const auto& current = *config.load(std::memory_order_acquire);
+    if (!isRateLimited(current, context, level))
     {
       auto message = makeMessage(context);
       message->level = level;
-      message->content = messgeCallback();
+      fill(*message, site);
+      if (site)
+      {
+        site->addBytes(message->content.size());
+      }
 
-      sink->send(std::move(message));
-      autoFlushIfNeeded(level);
+      current.sink->send(std::move(message));
+      if (level >= current.autoFlushLevel)
+      {
+        current.sink->flush();
+      }
     }
   }
 
+  static const LoggerConfig* makeDefaultConfig()
+  {
+    auto result = new LoggerConfig();
+    result->sink = std::make_shared< NullSink >();
+    return result;
+  }
+
   std::unique_ptr< Message > makeMessage(const CallContext& context)
   {
     return std::make_unique< Message >(context, loggerContext);
   }
 
-  void autoFlushIfNeeded(Level level)
+  /* checked before the message is created, reports suppressed messages of the call site */
+  bool isRateLimited(const LoggerConfig& current, const CallContext& context, Level level)
   {
-    if (level >= autoFlushLevel)
+    if (!current.rateLimiter)
+    {
+      return false;
+    }
+
+    std::uint64_t suppressed;
+    if (!current.rateLimiter->admit(context, level, loggerContext.get(), suppressed))
     {
-      sink->flush();
+      return true;
     }
+
+    if (suppressed)
+    {
+      sendSuppressed(current, context, level, suppressed);
+    }
+    return false;
   }
 
+  /* of the sites which stopped admitting messages */
+  void reportSuppressed(const LoggerConfig& current)
+  {
+    const auto now = RateLimiter::Clock::now().time_since_epoch().count();
+    auto next = nextSuppressedCheck.load(std::memory_order_relaxed);
+    if (now < next || !nextSuppressedCheck.compare_exchange_strong(next,
+      now + current.rateLimiter->getSummaryInterval().count(), std::memory_order_relaxed))
+    {
+      return;
+    }
+
+    std::vector< RateLimiter::Suppressed > summaries;
+    current.rateLimiter->takeSuppressed(loggerContext.get(), summaries);
+    for (const auto& summary : summaries)
+    {
+      sendSuppressed(current, summary.context, summary.level, summary.count);
+    }
+  }
 
+  void sendSuppressed(const LoggerConfig& current, const CallContext& context, Level level, std::uint64_t count)
+  {
+    auto message = makeMessage(context);
+    message->level = level;
+    message->content = "suppressed " + std::to_string(count) + " messages from "
+      + context.file + ":" + std::to_string(context.line);
+    current.sink->send(std::move(message));
+  }
 };
 
 } // end logger
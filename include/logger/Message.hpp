@@ -1,30 +1,70 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <chrono>
+#include <cstdint>
 #include <string>
 #include <thread>
 
+#include "logger/CommitHandle.hpp"
+
 #ifdef _MSC_VER
-#define LOGGER_CALL_CONTEXT CallContext(__FUNCTION__, __FUNCSIG__, __FILE__, __LINE__)
+#define LOGGER_DECORATED_FUNCTION __FUNCSIG__
 #else
-#define LOGGER_CALL_INFO SourceCodeContext(__FUNCTION__, __PRETTY_FUNCTION__, __FILE__, __LINE__)
+#define LOGGER_DECORATED_FUNCTION __PRETTY_FUNCTION__
 #endif
 
+/* the lambda gives every expansion its own static CallSite, constant initialized (no guard) */
+#define LOGGER_CALL_CONTEXT CallContext(__FUNCTION__, LOGGER_DECORATED_FUNCTION, __FILE__, __LINE__, \
+  []() { static ::logger::details::CallSite site; return &site; }())
+
 namespace logger
 {
+namespace details
+{
+
+/* per call site state owned by the site (see LOGGER_CALL_CONTEXT), managed by CallSiteRegistry */
+struct CallSite
+{
+  static const std::uint8_t UNREGISTERED = 0; // not executed yet
+  static const std::uint8_t DEFAULT = 1;      // the logger's filteringLevel decides
+  static const std::uint8_t ENABLED = 2;      // logged at any level
+  static const std::uint8_t DISABLED = 3;     // never logged
+
+  constexpr CallSite()
+    :
+    state(UNREGISTERED),
+    function(nullptr),
+    file(nullptr),
+    line(0),
+    next(nullptr)
+  {
+  }
+
+  std::atomic< std::uint8_t > state;
+
+  // set on registration
+  const char* function;
+  const char* file;
+  unsigned int line;
+  CallSite* next;
+};
 
+} // details
 
 /** source code specyfic information
  */
 struct CallContext
 {
-  CallContext(const char* aFunc, const char* aDecorated, const char* aFile, unsigned int aLine)
+  CallContext(const char* aFunc, const char* aDecorated, const char* aFile, unsigned int aLine,
+    details::CallSite* aSite = nullptr)
     :
     function(aFunc),
     decoratedFunction(aDecorated),
     file(aFile),
-    line(aLine)
+    line(aLine),
+    site(aSite)
   {
   }
 
@@ -34,6 +74,7 @@ struct CallContext
   const char* decoratedFunction;
   const char* file;
   const unsigned int line;
+  details::CallSite* site; // nullptr - the context was not made by LOGGER_CALL_CONTEXT
 };
 
 /* logger specyfic information
@@ -82,6 +123,8 @@ struct Message
 
   Level level;
   std::string content;
+  std::string fields; // binary encoded key/value pairs (see StructuredFields.hpp), usually empty
+  CommitTicket commit; // set for durable messages only (Logger::logDurable)
 
   // additional information
   std::chrono::time_point< DefaultClock > time;
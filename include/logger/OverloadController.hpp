@@ -0,0 +1,165 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "logger/Logger.hpp"
+#include "logger/StringHelpers.hpp"
+
+namespace logger
+{
+
+/* thresholds of OverloadController, the gap between high and low is the hysteresis */
+struct OverloadPolicy
+{
+  std::size_t highWatermark = 100000;  // queued messages starting the degradation
+  std::size_t lowWatermark = 10000;    // queued messages ending it
+  DefaultClock::duration highLag = std::chrono::seconds(1);
+  DefaultClock::duration lowLag = std::chrono::milliseconds(100);
+  Level degradedLevel = Level::WARNING;                                  // effective level of degraded loggers
+  DefaultClock::duration minimumDuration = std::chrono::seconds(1);      // a degradation lasts at least that long
+  DefaultClock::duration checkInterval = std::chrono::milliseconds(10);
+};
+
+/** Sheds low level messages instead of queueing them without bound when a sink's consumer falls behind.
+ *
+ * check() reads the Backlog of the loggers' sinks. When a sink exceeds the high watermark (queued
+ * messages or lag), its loggers are degraded (Logger::degrade) to policy.degradedLevel; when it is
+ * back below both low ones, and at least minimumDuration later, they are restored. Each transition
+ * is logged through the logger itself, the restoration with the number of messages shed.
+ * Producers are not involved: they only see a higher filteringLevel.
+ * Loggers already configured at policy.degradedLevel or above are left alone.
+ * Not thread safe, meant for one periodic caller - not the thread consuming the queues, which is
+ * the one falling behind (MultithreadRegistryHandle runs it on a thread of its own).
+ */
+class OverloadController
+{
+public:
+  explicit OverloadController(const OverloadPolicy& aPolicy = OverloadPolicy())
+    :
+    policy(aPolicy)
+  {
+  }
+
+  const OverloadPolicy& getPolicy() const
+  {
+    return policy;
+  }
+
+  /* call every policy.checkInterval */
+  void check(const std::vector< std::shared_ptr< Logger > >& loggers)
+  {
+    const auto now = DefaultClock::now();
+
+    std::unordered_map< Sink*, SinkState > checked;
+    for (const auto& logger : loggers)
+    {
+      auto sink = logger->getSink();
+      auto found = checked.find(sink.get());
+      if (found == checked.end())
+      {
+        found = checked.emplace(sink.get(), update(sink.get(), now)).first;
+      }
+
+      const auto& state = found->second;
+      if (state.overloaded && !logger->isDegraded() && logger->getLevel() < policy.degradedLevel)
+      {
+        degrade(*logger, state.backlog);
+      }
+      else if (!state.overloaded && logger->isDegraded())
+      {
+        restore(*logger);
+      }
+    }
+    states.swap(checked); // forgets sinks no logger uses anymore
+  }
+
+  /* restores all degraded loggers, e.g. when the controller is replaced */
+  void restoreAll(const std::vector< std::shared_ptr< Logger > >& loggers)
+  {
+    for (const auto& logger : loggers)
+    {
+      if (logger->isDegraded())
+      {
+        restore(*logger);
+      }
+    }
+    states.clear();
+  }
+
+private:
+  struct SinkState
+  {
+    bool overloaded = false;
+    DefaultClock::time_point since; // of the degradation
+    Backlog backlog;
+  };
+
+  const OverloadPolicy policy;
+  std::unordered_map< Sink*, SinkState > states; // of the previous check
+
+  SinkState update(Sink* sink, DefaultClock::time_point now)
+  {
+    SinkState state;
+    auto previous = states.find(sink);
+    if (previous != states.end())
+    {
+      state = previous->second;
+    }
+
+    state.backlog = sink->getBacklog();
+    if (!state.overloaded)
+    {
+      if (state.backlog.messages >= policy.highWatermark || state.backlog.lag >= policy.highLag)
+      {
+        state.overloaded = true;
+        state.since = now;
+      }
+    }
+    else if (state.backlog.messages <= policy.lowWatermark && state.backlog.lag <= policy.lowLag
+      && now - state.since >= policy.minimumDuration)
+    {
+      state.overloaded = false;
+    }
+    return state;
+  }
+
+  void degrade(Logger& logger, const Backlog& backlog)
+  {
+    const auto level = logger.getLevel();
+    logger.degrade(policy.degradedLevel);
+    report(logger, "overload: " + std::to_string(backlog.messages) + " messages queued, lag "
+      + std::to_string(std::chrono::duration_cast< std::chrono::milliseconds >(backlog.lag).count())
+      + " ms, level raised from " + toString(level) + " to " + toString(logger.getEffectiveLevel()));
+  }
+
+  void restore(Logger& logger)
+  {
+    const auto shed = logger.restore();
+    report(logger, "overload over: level restored to " + std::string(toString(logger.getLevel()))
+      + ", " + std::to_string(shed) + " messages shed");
+  }
+
+  /* at a level passing the degradation */
+  void report(Logger& logger, std::string&& text)
+  {
+    switch (std::max(policy.degradedLevel, Level::WARNING))
+    {
+    case Level::WARNING:
+      logger.warning(LOGGER_CALL_CONTEXT, std::move(text));
+      break;
+    case Level::ERROR:
+      logger.error(LOGGER_CALL_CONTEXT, std::move(text));
+      break;
+    default:
+      logger.critical(LOGGER_CALL_CONTEXT, std::move(text));
+      break;
+    }
+  }
+};
+
+} // logger
@@ -0,0 +1,326 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "logger/Message.hpp"
+
+namespace logger
+{
+
+/** Call site scoped rate limiting, checked by Logger before a Message is created.
+ *
+ * State is kept per (limiter, call site) in a thread local table, so the check never
+ * touches memory shared with other threads - limits apply to each thread separately.
+ * Messages suppressed at a site are reported at most once per `summaryInterval`: by the next
+ * message admitted from that site or, for a site not admitting anymore, by Logger::flush()
+ * (takeSuppressed()), through the logger of the last suppressed message.
+ * Entries of sites not used between two sweeps of a thread's table (run when the table doubled)
+ * are evicted, with the entries of destroyed limiters; an evicted site starts again.
+ */
+class RateLimiter
+{
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  /* messages of a call site suppressed and not reported yet */
+  struct Suppressed
+  {
+    CallContext context;
+    Level level; // of the last one
+    std::uint64_t count;
+  };
+
+  enum class Mode
+  {
+    TOKEN_BUCKET,         // `rate` messages per second, bursts of up to `burst`
+    SAMPLING,             // every `every`-th message
+    FIRST_N_THEN_EVERY_M  // the first `first` messages, then every `every`-th
+  };
+
+  static std::shared_ptr< RateLimiter > tokenBucket(double messagesPerSecond, std::uint32_t burst,
+                                                    Clock::duration summaryInterval = std::chrono::seconds(1))
+  {
+    return std::make_shared< RateLimiter >(Mode::TOKEN_BUCKET, messagesPerSecond, burst, 0, summaryInterval);
+  }
+
+  static std::shared_ptr< RateLimiter > sampling(std::uint32_t oneIn,
+                                                 Clock::duration summaryInterval = std::chrono::seconds(1))
+  {
+    return std::make_shared< RateLimiter >(Mode::SAMPLING, 0., 0, oneIn, summaryInterval);
+  }
+
+  static std::shared_ptr< RateLimiter > firstThenEvery(std::uint32_t first, std::uint32_t every,
+                                                       Clock::duration summaryInterval = std::chrono::seconds(1))
+  {
+    return std::make_shared< RateLimiter >(Mode::FIRST_N_THEN_EVERY_M, 0., first, every, summaryInterval);
+  }
+
+  RateLimiter(Mode aMode, double aRate, std::uint32_t aBurstOrFirst, std::uint32_t aEvery, Clock::duration aSummaryInterval)
+    :
+    id(nextId()),
+    mode(aMode),
+    rate(aRate),
+    burstOrFirst(aBurstOrFirst),
+    every(aEvery ? aEvery : 1),
+    summaryInterval(aSummaryInterval)
+  {
+  }
+
+  Clock::duration getSummaryInterval() const
+  {
+    return summaryInterval;
+  }
+
+  /* returns true if the message should be logged
+   * `suppressed` is set to the number of messages to report as suppressed (usually 0)
+   */
+  bool admit(const CallContext& context, Level level, const LoggerContext* logger, std::uint64_t& suppressed)
+  {
+    auto& site = getSite(context);
+    suppressed = 0;
+
+    auto& pending = *site.pending;
+    if (!passes(site))
+    {
+      pending.level.store(level, std::memory_order_relaxed);
+      pending.logger.store(logger, std::memory_order_relaxed);
+      pending.count.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    if (pending.count.load(std::memory_order_relaxed))
+    {
+      suppressed = take(pending, Clock::now());
+    }
+    return true;
+  }
+
+  /* appends the messages suppressed by the logger and not reported for `summaryInterval` */
+  void takeSuppressed(const LoggerContext* logger, std::vector< Suppressed >& result)
+  {
+    const auto now = Clock::now();
+    std::lock_guard< std::mutex > lock(pendingMt);
+    for (const auto& entry : pendings)
+    {
+      auto& pending = *entry;
+      if (pending.count.load(std::memory_order_relaxed) && pending.logger.load(std::memory_order_relaxed) == logger)
+      {
+        if (const auto count = take(pending, now))
+        {
+          result.push_back(Suppressed{ CallContext(pending.function, pending.decoratedFunction, pending.file, pending.line),
+            pending.level.load(std::memory_order_relaxed), count });
+        }
+      }
+    }
+    prune();
+  }
+
+private:
+  struct SiteKey
+  {
+    std::uint64_t limiter;
+    const char* file;
+    unsigned int line;
+
+    bool operator==(const SiteKey& other) const
+    {
+      return limiter == other.limiter && file == other.file && line == other.line;
+    }
+  };
+
+  struct SiteKeyHash
+  {
+    std::size_t operator()(const SiteKey& key) const
+    {
+      auto hash = std::hash< const void* >()(key.file);
+      hash ^= (std::size_t(key.line) << 16) ^ std::size_t(key.limiter) * 0x9e3779b97f4a7c15ull;
+      return hash;
+    }
+  };
+
+  /* shared by the thread's table and the limiter, which reports it when the site is idle */
+  struct Pending
+  {
+    explicit Pending(const CallContext& context)
+      :
+      function(context.function),
+      decoratedFunction(context.decoratedFunction),
+      file(context.file),
+      line(context.line),
+      logger(nullptr),
+      level(Level::TRACE),
+      count(0),
+      lastReport(0)
+    {
+    }
+
+    const char* function;
+    const char* decoratedFunction;
+    const char* file;
+    const unsigned int line;
+    std::atomic< const LoggerContext* > logger; // of the last suppressed message, only compared
+    std::atomic< Level > level;
+    std::atomic< std::uint64_t > count;
+    std::atomic< Clock::rep > lastReport;
+  };
+
+  struct SiteState
+  {
+    std::uint64_t count = 0;
+    double tokens = -1.; // negative - bucket not initialized yet
+    Clock::time_point lastRefill;
+    std::uint64_t generation = 0; // of the thread's table when last used
+    std::shared_ptr< Pending > pending;
+  };
+
+  /* a thread's states of all limiters */
+  struct SiteTable
+  {
+    std::unordered_map< SiteKey, SiteState, SiteKeyHash > sites;
+    std::uint64_t generation = 0;
+    std::size_t sweepSize = MIN_SWEEP_SIZE; // the next sweep runs when sites reach it
+  };
+
+  static const std::size_t MIN_SWEEP_SIZE = 64;
+
+  const std::uint64_t id;
+  const Mode mode;
+  const double rate;
+  const std::uint32_t burstOrFirst;
+  const std::uint32_t every;
+  const Clock::duration summaryInterval;
+
+  std::mutex pendingMt; // guards pendings and pruneSize
+  std::vector< std::shared_ptr< Pending > > pendings; // of all threads
+  std::size_t pruneSize = MIN_SWEEP_SIZE;             // pendings are pruned when they reach it
+
+  static std::uint64_t nextId()
+  {
+    static std::atomic< std::uint64_t > counter(0);
+    return ++counter;
+  }
+
+  SiteState& getSite(const CallContext& context)
+  {
+    thread_local SiteTable table;
+    const SiteKey key{ id, context.file, context.line };
+    auto found = table.sites.find(key);
+    if (found == table.sites.end())
+    {
+      if (table.sites.size() >= table.sweepSize)
+      {
+        sweep(table);
+      }
+      found = table.sites.emplace(key, SiteState()).first;
+      found->second.pending = std::make_shared< Pending >(context);
+      std::lock_guard< std::mutex > lock(pendingMt);
+      if (pendings.size() >= pruneSize)
+      {
+        prune();
+      }
+      pendings.push_back(found->second.pending);
+    }
+    found->second.generation = table.generation;
+    return found->second;
+  }
+
+  /* evicts the sites not used since the previous sweep */
+  static void sweep(SiteTable& table)
+  {
+    for (auto site = table.sites.begin(); site != table.sites.end();)
+    {
+      if (site->second.generation != table.generation)
+      {
+        site = table.sites.erase(site);
+      }
+      else
+      {
+        ++site;
+      }
+    }
+    ++table.generation;
+    const auto doubled = table.sites.size() * 2;
+    table.sweepSize = doubled > MIN_SWEEP_SIZE ? doubled : MIN_SWEEP_SIZE;
+  }
+
+  /* drops the entries evicted by their threads and reported, pendingMt has to be locked */
+  void prune()
+  {
+    for (std::size_t i = 0; i < pendings.size();)
+    {
+      if (pendings[i].use_count() == 1 && !pendings[i]->count.load(std::memory_order_relaxed))
+      {
+        pendings[i] = std::move(pendings.back());
+        pendings.pop_back();
+      }
+      else
+      {
+        ++i;
+      }
+    }
+    const auto doubled = pendings.size() * 2;
+    pruneSize = doubled > MIN_SWEEP_SIZE ? doubled : MIN_SWEEP_SIZE;
+  }
+
+  /* the count to report, 0 if reported less than `summaryInterval` ago */
+  std::uint64_t take(Pending& pending, Clock::time_point now)
+  {
+    const auto ticks = now.time_since_epoch().count();
+    auto last = pending.lastReport.load(std::memory_order_relaxed);
+    if (ticks - last < summaryInterval.count()
+      || !pending.lastReport.compare_exchange_strong(last, ticks, std::memory_order_relaxed))
+    {
+      return 0;
+    }
+    return pending.count.exchange(0, std::memory_order_relaxed);
+  }
+
+  bool passes(SiteState& site)
+  {
+    const auto index = site.count++;
+    switch (mode)
+    {
+    case Mode::SAMPLING:
+      return index % every == 0;
+
+    case Mode::FIRST_N_THEN_EVERY_M:
+      return index < burstOrFirst || (index - burstOrFirst) % every == 0;
+
+    case Mode::TOKEN_BUCKET:
+    default:
+      return takeToken(site);
+    }
+  }
+
+  bool takeToken(SiteState& site)
+  {
+    auto now = Clock::now();
+    if (site.tokens < 0.)
+    {
+      site.tokens = burstOrFirst;
+    }
+    else
+    {
+      const std::chrono::duration< double > elapsed = now - site.lastRefill;
+      site.tokens = std::min< double >(burstOrFirst, site.tokens + elapsed.count() * rate);
+    }
+    site.lastRefill = now;
+
+    if (site.tokens < 1.)
+    {
+      return false;
+    }
+    site.tokens -= 1.;
+    return true;
+  }
+};
+
+} // logger
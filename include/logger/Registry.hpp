@@ -4,12 +4,21 @@
 
 #include "logger/Logger.hpp"
 #include "logger/SinkFactory.hpp"
+#include "logger/CallSiteRegistry.hpp"
+#include "logger/OverloadController.hpp"
 
 namespace logger
 {
 
 typedef std::shared_ptr< Logger > LoggerPtr;
 
+/* result of RegistryHandle::shutdown */
+struct ShutdownReport
+{
+  std::uint64_t lostMessages = 0;  // dropped after close or not delivered before the deadline
+  std::size_t unfinishedSinks = 0; // still draining at the deadline (blocked on a write), their losses are unknown
+};
+
 class RegistryHandle
 {
 public:
@@ -19,6 +28,41 @@ public:
   virtual LoggerPtr unregisterLogger(const std::string& name) = 0;
   virtual void registerLogger(LoggerPtr logger) = 0;
 
+  /* Hierarchical configuration, names are dotted paths ("net.tcp.session"), "" is the root.
+   * A logger inherits each setting from its nearest configured ancestor (or itself).
+   * Settings are resolved into the loggers when the configuration changes or a logger is registered.
+   */
+  virtual void setLevel(const std::string& name, Level level) = 0;
+  virtual void setAutoFlushLevel(const std::string& name, Level level) = 0;
+  virtual void setSink(const std::string& name, std::shared_ptr< Sink > sink) = 0;
+
+  /* Single log statements, whatever their logger's level, see CallSiteRegistry for the patterns */
+  virtual void enableCallSites(const std::string& pattern)
+  {
+    CallSiteRegistry::instance().enable(pattern);
+  }
+
+  virtual void disableCallSites(const std::string& pattern)
+  {
+    CallSiteRegistry::instance().disable(pattern);
+  }
+
+  virtual void resetCallSites(const std::string& pattern)
+  {
+    CallSiteRegistry::instance().reset(pattern);
+  }
+
+  /* Overload control (see OverloadController): loggers of sinks falling behind are degraded
+   * to policy.degradedLevel until the sinks catch up. Disabling restores all of them.
+   */
+  virtual void enableOverloadControl(const OverloadPolicy& policy) = 0;
+  virtual void disableOverloadControl() = 0;
+
+  /* Orderly shutdown, returns within `timeout`: the loggers' sinks stop accepting messages
+   * and are drained in parallel. Loggers keep working, their messages are dropped (and counted).
+   */
+  virtual ShutdownReport shutdown(std::chrono::milliseconds timeout) = 0;
+
   // TODO maybe it should be separated from Logger functions?
   virtual std::shared_ptr< SinkFactory > getSinkFactory() = 0;
 };
@@ -1,10 +1,21 @@
 #pragma once
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
 #include "logger/Message.hpp"
 
 namespace logger
 {
 
+/* how far behind the consumer of a queueing sink is, see OverloadController */
+struct Backlog
+{
+  std::size_t messages = 0;                                     // queued, not delivered yet
+  DefaultClock::duration lag = DefaultClock::duration::zero();  // age of the oldest message of the current (or last) delivery
+};
+
 class Sink
 {
 public:
@@ -13,6 +24,57 @@ public:
 
   virtual void send(std::unique_ptr< Message > message) = 0;
   virtual void flush() = 0;
+
+  /* publishes many messages at once, sinks with a shared queue override it to synchronize once
+   * the messages are moved out, the vector itself stays with the caller
+   */
+  virtual void sendBulk(std::vector< std::unique_ptr< Message > >& messages)
+  {
+    for (auto& message : messages)
+    {
+      send(std::move(message));
+    }
+  }
+
+  /* `text` - the messages already formatted, in order (see ParallelFormattingSink), sinks writing
+   * text override it to write it as it is; the others send the messages (and format them again)
+   */
+  virtual void sendFormatted(const std::string& /*text*/, std::vector< std::unique_ptr< Message > >& messages)
+  {
+    sendBulk(messages);
+  }
+
+  /* Shutdown (see RegistryHandle::shutdown): after close() messages sent are dropped,
+   * drain() delivers the pending ones until the deadline and returns the number of lost messages
+   * (dropped after close or not delivered in time). A write in progress is not interrupted.
+   */
+  virtual void close()
+  {
+  }
+
+  virtual std::uint64_t drain(DefaultClock::time_point /*deadline*/)
+  {
+    flush();
+    return 0;
+  }
+
+  /* sinks without a queue of their own report none */
+  virtual Backlog getBacklog()
+  {
+    return Backlog();
+  }
+
+  /* Crash path (see EmergencyFlush): writes pending raw content to the descriptor.
+   * Has to be async-signal-safe: no allocation, no waiting for locks.
+   * Sinks wrapping another one write its content first. Covered: the multithread sinks' queues
+   * and held back messages, BatchingSink, ParallelFormattingSink and the buffers of the console,
+   * file, compressed file, async file and flight recorder sinks. Not covered: writes already handed
+   * to an AsyncFileWriter, SocketSink and SharedMemorySink batches, and sinks reached by neither
+   * a registered sink (multithread, batching, flight recorder) nor one wrapping them.
+   */
+  virtual void emergencyWrite(int /*fd*/)
+  {
+  }
 };
 
 class NullSink : public Sink
@@ -17,9 +17,33 @@ public:
   SinkFactory() = default;
   virtual ~SinkFactory() = default;
 
+  /* stdout, messages at WARNING and above to stderr */
   virtual SinkPtr createStandardOutputSink(Formatter formatter) = 0;
 
   virtual SinkPtr createFileSink(const std::string& name, Formatter formatter) = 0;
+
+  /* file sink with a sparse time index (<name>.idx), an entry every `indexInterval` bytes, see src/query */
+  virtual SinkPtr createIndexedFileSink(const std::string& name, Formatter formatter, std::size_t indexInterval) = 0;
+
+  /* file sink with asynchronous, multi-buffered writes (io_uring where available) */
+  virtual SinkPtr createAsyncFileSink(const std::string& name, Formatter formatter) = 0;
+
+  /* file sink formatting on several threads, `formatter` has to be thread safe */
+  virtual SinkPtr createParallelFormattingFileSink(const std::string& name, Formatter formatter) = 0;
+
+  /* file sink writing LZ4 compressed frames and a frame index (<name>.idx), see src/reader */
+  virtual SinkPtr createCompressedFileSink(const std::string& name, Formatter formatter) = 0;
+
+  /* endpoint: udp://host:port, tcp://host:port, unix:///path or unixgram:///path */
+  virtual SinkPtr createSocketSink(const std::string& endpoint, Formatter formatter) = 0;
+
+  /* stages messages per thread and publishes them to `sink` in bulk */
+  virtual SinkPtr createBatchingSink(SinkPtr sink) = 0;
+
+  /* keeps the recent history in memory, dumps it to the file on a message at or above triggerLevel
+   * has to be used directly, without a multithread sink in front of it
+   */
+  virtual SinkPtr createFlightRecorderSink(const std::string& dumpFileName, Formatter formatter, Level triggerLevel) = 0;
 };
 
 } // logger
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include <string>
 #include <sstream>
 
+#include "logger/Message.hpp"
+
 namespace logger
 {
 
@@ -18,7 +20,7 @@ std::string string_format(const std::string& format, Args ... args)
   return std::move(result);
 }
 
-std::string toString(const std::thread::id& id)
+inline std::string toString(const std::thread::id& id)
 {
   std::ostringstream buffer;
   buffer << id;
@@ -26,4 +28,36 @@ std::string toString(const std::thread::id& id)
 
 }
 
+inline const char* toString(Level level)
+{
+  switch (level)
+  {
+  case Level::TRACE: return "TRACE";
+  case Level::DEBUG_FINEST: return "DEBUG_FINEST";
+  case Level::DEBUG_FINER: return "DEBUG_FINER";
+  case Level::DEBUG_FINE: return "DEBUG_FINE";
+  case Level::DEBUG: return "DEBUG";
+  case Level::INFO: return "INFO";
+  case Level::WARNING: return "WARNING";
+  case Level::ERROR: return "ERROR";
+  case Level::CRITICAL: return "CRITICAL";
+  case Level::NEVER: return "NEVER";
+  }
+  return "UNKNOWN";
+}
+
+/* inverse of toString(Level), returns false for an unknown name */
+inline bool parseLevel(const std::string& name, Level& level)
+{
+  for (int value = static_cast< int >(Level::TRACE); value <= static_cast< int >(Level::NEVER); ++value)
+  {
+    if (name == toString(static_cast< Level >(value)))
+    {
+      level = static_cast< Level >(value);
+      return true;
+    }
+  }
+  return false;
+}
+
 } // logger
\ No newline at end of file
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+namespace logger
+{
+
+/** Structured key/value fields attached to a Message
+ *
+ * logger->info(LOGGER_CALL_CONTEXT, "order filled", kv("id", id), kv("px", px));
+ *
+ * Fields are encoded on the producer side into Message::fields, a compact binary buffer:
+ *   [uint8 type][uint16 key size][key][value]
+ * where the value is 8 bytes for numbers, 1 byte for bool and [uint32 size][bytes] for text.
+ * Formatting (e.g. JsonFormatter) happens on the consumer side.
+ */
+enum class FieldType : std::uint8_t
+{
+  INT = 1,
+  UINT,
+  DOUBLE,
+  BOOL,
+  STRING
+};
+
+template< typename T >
+struct KeyValue
+{
+  const char* key;
+  const T& value;
+};
+
+template< typename T >
+KeyValue< T > kv(const char* key, const T& value)
+{
+  return KeyValue< T >{ key, value };
+}
+
+namespace details
+{
+
+inline void appendRaw(std::string& out, const void* data, std::size_t size)
+{
+  out.append(static_cast< const char* >(data), size);
+}
+
+inline void appendHeader(std::string& out, FieldType type, const char* key)
+{
+  const auto keySize = static_cast< std::uint16_t >(std::strlen(key));
+  out.push_back(static_cast< char >(type));
+  appendRaw(out, &keySize, sizeof(keySize));
+  out.append(key, keySize);
+}
+
+inline void appendText(std::string& out, const char* key, const char* text, std::size_t size)
+{
+  appendHeader(out, FieldType::STRING, key);
+  const auto size32 = static_cast< std::uint32_t >(size);
+  appendRaw(out, &size32, sizeof(size32));
+  out.append(text, size);
+}
+
+inline void encodeField(std::string& out, const char* key, bool value)
+{
+  appendHeader(out, FieldType::BOOL, key);
+  out.push_back(value ? 1 : 0);
+}
+
+template< typename T >
+typename std::enable_if< std::is_integral< T >::value && std::is_signed< T >::value >::type
+encodeField(std::string& out, const char* key, T value)
+{
+  const auto wide = static_cast< std::int64_t >(value);
+  appendHeader(out, FieldType::INT, key);
+  appendRaw(out, &wide, sizeof(wide));
+}
+
+template< typename T >
+typename std::enable_if< std::is_integral< T >::value && !std::is_signed< T >::value >::type
+encodeField(std::string& out, const char* key, T value)
+{
+  const auto wide = static_cast< std::uint64_t >(value);
+  appendHeader(out, FieldType::UINT, key);
+  appendRaw(out, &wide, sizeof(wide));
+}
+
+template< typename T >
+typename std::enable_if< std::is_floating_point< T >::value >::type
+encodeField(std::string& out, const char* key, T value)
+{
+  const auto wide = static_cast< double >(value);
+  appendHeader(out, FieldType::DOUBLE, key);
+  appendRaw(out, &wide, sizeof(wide));
+}
+
+inline void encodeField(std::string& out, const char* key, const char* value)
+{
+  appendText(out, key, value, std::strlen(value));
+}
+
+inline void encodeField(std::string& out, const char* key, const std::string& value)
+{
+  appendText(out, key, value.data(), value.size());
+}
+
+inline void encodeFields(std::string&)
+{
+}
+
+template< typename T, typename... Rest >
+void encodeFields(std::string& out, const KeyValue< T >& field, const KeyValue< Rest >&... rest)
+{
+  encodeField(out, field.key, field.value);
+  encodeFields(out, rest...);
+}
+
+} // details
+
+/* decoded field, `key` and `text` point into the encoded buffer */
+struct FieldView
+{
+  FieldType type;
+  const char* key;
+  std::size_t keySize;
+  union
+  {
+    std::int64_t intValue;
+    std::uint64_t uintValue;
+    double doubleValue;
+    bool boolValue;
+  };
+  const char* text;
+  std::size_t textSize;
+};
+
+/* iterates over fields encoded in Message::fields */
+class FieldReader
+{
+public:
+  explicit FieldReader(const std::string& aFields)
+    :
+    position(aFields.data()),
+    end(aFields.data() + aFields.size())
+  {
+  }
+
+  /* returns false at the end or on a malformed buffer */
+  bool next(FieldView& field)
+  {
+    std::uint16_t keySize;
+    if (!available(1 + sizeof(keySize)))
+    {
+      return false;
+    }
+    field.type = static_cast< FieldType >(*position++);
+    read(&keySize, sizeof(keySize));
+    if (!available(keySize))
+    {
+      return false;
+    }
+    field.key = position;
+    field.keySize = keySize;
+    position += keySize;
+    field.text = nullptr;
+    field.textSize = 0;
+
+    switch (field.type)
+    {
+    case FieldType::INT:
+    case FieldType::UINT:
+    case FieldType::DOUBLE:
+      return available(8) && read(&field.uintValue, 8);
+    case FieldType::BOOL:
+      if (!available(1))
+      {
+        return false;
+      }
+      field.boolValue = *position++ != 0;
+      return true;
+    case FieldType::STRING:
+    {
+      std::uint32_t size;
+      if (!available(sizeof(size)) || !read(&size, sizeof(size)) || !available(size))
+      {
+        return false;
+      }
+      field.text = position;
+      field.textSize = size;
+      position += size;
+      return true;
+    }
+    }
+    return false;
+  }
+
+private:
+  const char* position;
+  const char* end;
+
+  bool available(std::size_t size) const
+  {
+    return static_cast< std::size_t >(end - position) >= size;
+  }
+
+  bool read(void* destination, std::size_t size)
+  {
+    std::memcpy(destination, position, size);
+    position += size;
+    return true;
+  }
+};
+
+} // logger
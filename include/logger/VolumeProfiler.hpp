@@ -0,0 +1,360 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "logger/Message.hpp"
+
+namespace logger
+{
+namespace details
+{
+
+/* counters of one call site in one thread's table
+ * written only by the owning thread (plain load + store, no locked instructions), read by reports
+ */
+struct SiteCounters
+{
+  std::atomic< const char* > file; // nullptr - free entry, published last
+  const char* function;
+  unsigned int line;
+
+  std::atomic< std::uint64_t > calls;
+  std::atomic< std::uint64_t > filtered;      // rejected by the logger's filteringLevel
+  std::atomic< std::uint64_t > bytes;         // of content
+  std::atomic< std::uint64_t > callbackNanos; // spent in MakeMessageCallback
+
+  void addCall()
+  {
+    add(calls, 1);
+  }
+
+  void addFiltered()
+  {
+    add(filtered, 1);
+  }
+
+  void addBytes(std::uint64_t size)
+  {
+    add(bytes, size);
+  }
+
+  void addCallbackTime(std::chrono::steady_clock::duration time)
+  {
+    add(callbackNanos, std::chrono::duration_cast< std::chrono::nanoseconds >(time).count());
+  }
+
+private:
+  static void add(std::atomic< std::uint64_t >& counter, std::uint64_t value)
+  {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  }
+};
+
+} // details
+
+/* Optional per call site volume profiling: which log statements produce the calls and bytes.
+ *
+ * Off by default; while disabled Logger pays one relaxed load per call. When enabled, every
+ * thread counts into its own fixed size table of sites (no locks, no shared cache lines),
+ * report() merges the tables of all threads, including exited ones.
+ * Process wide and never destroyed, so it can be reported from an exit handler.
+ */
+class VolumeProfiler
+{
+public:
+  static const std::size_t SITES_PER_THREAD = 1024; // sites beyond it are counted as "<other>"
+
+  enum class SortBy
+  {
+    BYTES,
+    CALLS,
+    CALLBACK_TIME
+  };
+
+  struct SiteReport
+  {
+    std::string file;
+    unsigned int line;
+    std::string function;
+    std::uint64_t calls;
+    std::uint64_t filtered;
+    std::uint64_t bytes;
+    std::uint64_t callbackNanos;
+  };
+
+  static VolumeProfiler& instance()
+  {
+    static VolumeProfiler* profiler = new VolumeProfiler();
+    return *profiler;
+  }
+
+  static bool isEnabled()
+  {
+    return enabledFlag().load(std::memory_order_relaxed);
+  }
+
+  void enable()
+  {
+    enabledFlag().store(true, std::memory_order_relaxed);
+  }
+
+  void disable()
+  {
+    enabledFlag().store(false, std::memory_order_relaxed);
+  }
+
+  /* following reports count from now on */
+  void reset()
+  {
+    auto current = collect();
+    std::lock_guard< std::mutex > lock(mt);
+    baseline = std::move(current);
+  }
+
+  /* counters of the site for the calling thread */
+  details::SiteCounters* getSite(const CallContext& context)
+  {
+    thread_local const char* lastFile = nullptr;
+    thread_local unsigned int lastLine = 0;
+    thread_local details::SiteCounters* lastSite = nullptr;
+    if (lastFile == context.file && lastLine == context.line)
+    {
+      return lastSite;
+    }
+
+    auto site = localTable().find(context);
+    lastFile = context.file;
+    lastLine = context.line;
+    lastSite = site;
+    return site;
+  }
+
+  /* sites merged over all threads, sorted in descending order */
+  std::vector< SiteReport > getSites(SortBy sortBy = SortBy::BYTES) const
+  {
+    auto merged = collect();
+    std::vector< SiteReport > result;
+    {
+      std::lock_guard< std::mutex > lock(mt);
+      for (auto& entry : merged)
+      {
+        auto site = entry.second;
+        auto base = baseline.find(entry.first);
+        if (base != baseline.end())
+        {
+          site.calls -= std::min(site.calls, base->second.calls);
+          site.filtered -= std::min(site.filtered, base->second.filtered);
+          site.bytes -= std::min(site.bytes, base->second.bytes);
+          site.callbackNanos -= std::min(site.callbackNanos, base->second.callbackNanos);
+        }
+        if (site.calls)
+        {
+          result.push_back(site);
+        }
+      }
+    }
+
+    auto key = [sortBy](const SiteReport& site)
+    {
+      return sortBy == SortBy::CALLS ? site.calls : sortBy == SortBy::BYTES ? site.bytes : site.callbackNanos;
+    };
+    std::stable_sort(result.begin(), result.end(), [&key](const SiteReport& a, const SiteReport& b)
+    {
+      return key(a) > key(b);
+    }
+    );
+    return result;
+  }
+
+  /* text table of the `top` sites */
+  std::string report(std::size_t top = 20, SortBy sortBy = SortBy::BYTES) const
+  {
+    auto sites = getSites(sortBy);
+    std::uint64_t totalBytes = 0;
+    for (const auto& site : sites)
+    {
+      totalBytes += site.bytes;
+    }
+
+    std::string result = "       bytes  share       calls    filtered  callback ms  site\n";
+    char line[160];
+    for (std::size_t i = 0; i < sites.size() && i < top; ++i)
+    {
+      const auto& site = sites[i];
+      std::snprintf(line, sizeof(line), "%12llu %5.1f%% %11llu %11llu %12.3f  ",
+        static_cast< unsigned long long >(site.bytes),
+        totalBytes ? 100. * site.bytes / totalBytes : 0.,
+        static_cast< unsigned long long >(site.calls),
+        static_cast< unsigned long long >(site.filtered),
+        site.callbackNanos / 1e6);
+      result += line;
+      result += site.file + ":" + std::to_string(site.line) + " " + site.function + "\n";
+    }
+    return result;
+  }
+
+  /* writes report(top) to stderr when the process exits normally */
+  void reportAtExit(std::size_t top = 20)
+  {
+    exitReportSize() = top;
+    static const bool registered = std::atexit([]()
+    {
+      std::fputs(instance().report(exitReportSize()).c_str(), stderr);
+    }
+    ) == 0;
+    (void)registered;
+  }
+
+private:
+  typedef std::pair< std::string, unsigned int > SiteKey; // file, line: the same file may have several literals
+
+  /* table of one thread, adopted by a new thread after the owner exits */
+  struct Table
+  {
+    details::SiteCounters sites[SITES_PER_THREAD + 1]; // the last one is "<other>"
+    std::atomic< bool > inUse;
+    Table* next;
+
+    Table()
+      :
+      inUse(true),
+      next(nullptr)
+    {
+      for (auto& site : sites)
+      {
+        site.file.store(nullptr, std::memory_order_relaxed);
+        site.function = "";
+        site.line = 0;
+        site.calls.store(0, std::memory_order_relaxed);
+        site.filtered.store(0, std::memory_order_relaxed);
+        site.bytes.store(0, std::memory_order_relaxed);
+        site.callbackNanos.store(0, std::memory_order_relaxed);
+      }
+      sites[SITES_PER_THREAD].function = "";
+      sites[SITES_PER_THREAD].file.store("<other>", std::memory_order_release);
+    }
+
+    details::SiteCounters* find(const CallContext& context)
+    {
+      const auto hash = (reinterpret_cast< std::uintptr_t >(context.file) >> 3) * 0x9e3779b97f4a7c15ull + context.line;
+      for (std::size_t probe = 0; probe < SITES_PER_THREAD; ++probe)
+      {
+        auto& site = sites[(hash + probe) & (SITES_PER_THREAD - 1)];
+        const auto file = site.file.load(std::memory_order_relaxed);
+        if (file == context.file && site.line == context.line)
+        {
+          return &site;
+        }
+        if (!file)
+        {
+          site.function = context.function;
+          site.line = context.line;
+          site.file.store(context.file, std::memory_order_release);
+          return &site;
+        }
+      }
+      return &sites[SITES_PER_THREAD];
+    }
+  };
+
+  /* releases the thread's table when the thread exits, the counters stay */
+  struct ThreadEntry
+  {
+    Table* table;
+
+    ~ThreadEntry()
+    {
+      table->inUse.store(false, std::memory_order_release);
+    }
+  };
+
+  std::atomic< Table* > tables; // never shrinks
+  mutable std::mutex mt; // guards baseline
+  std::map< SiteKey, SiteReport > baseline;
+
+  VolumeProfiler()
+    :
+    tables(nullptr)
+  {
+  }
+
+  static std::atomic< bool >& enabledFlag()
+  {
+    static std::atomic< bool > enabled(false);
+    return enabled;
+  }
+
+  static std::size_t& exitReportSize()
+  {
+    static std::size_t size = 20;
+    return size;
+  }
+
+  Table& localTable()
+  {
+    thread_local ThreadEntry entry{ acquireTable() };
+    return *entry.table;
+  }
+
+  Table* acquireTable()
+  {
+    for (auto table = tables.load(std::memory_order_acquire); table; table = table->next)
+    {
+      bool expected = false;
+      if (!table->inUse.load(std::memory_order_relaxed)
+        && table->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire))
+      {
+        return table;
+      }
+    }
+
+    auto table = new Table();
+    table->next = tables.load(std::memory_order_relaxed);
+    while (!tables.compare_exchange_weak(table->next, table, std::memory_order_release, std::memory_order_relaxed))
+    {
+    }
+    return table;
+  }
+
+  std::map< SiteKey, SiteReport > collect() const
+  {
+    std::map< SiteKey, SiteReport > merged;
+    for (auto table = tables.load(std::memory_order_acquire); table; table = table->next)
+    {
+      for (const auto& site : table->sites)
+      {
+        const auto file = site.file.load(std::memory_order_acquire);
+        if (!file)
+        {
+          continue;
+        }
+
+        auto& total = merged[SiteKey(file, site.line)];
+        if (total.file.empty())
+        {
+          total.file = file;
+          total.line = site.line;
+          total.function = site.function;
+          total.calls = total.filtered = total.bytes = total.callbackNanos = 0;
+        }
+        total.calls += site.calls.load(std::memory_order_relaxed);
+        total.filtered += site.filtered.load(std::memory_order_relaxed);
+        total.bytes += site.bytes.load(std::memory_order_relaxed);
+        total.callbackNanos += site.callbackNanos.load(std::memory_order_relaxed);
+      }
+    }
+    return merged;
+  }
+};
+
+} // logger
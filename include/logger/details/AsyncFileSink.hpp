@@ -0,0 +1,248 @@
+#pragma once
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "logger/Sink.hpp"
+#include "logger/Formatter.hpp"
+
+#include "logger/details/AsyncFileWriter.hpp"
+#include "logger/details/EmergencyFlush.hpp"
+#include "logger/details/MemoryPolicy.hpp"
+
+namespace logger
+{
+namespace details
+{
+
+/* File sink which never waits for a single write:
+ * formatted messages are collected in one of `bufferCount` large buffers, a full buffer is handed
+ * to an AsyncFileWriter and the next free buffer is used meanwhile. The caller blocks only when
+ * all buffers are still being written. flush() (called after every drain by the registry's
+ * flushing thread) hands over a partial buffer only once it has been open for `maxBufferDelay`,
+ * so writes stay large under a steady load; a durable message, drain() and destruction hand it
+ * over at once (the file is not synced, durable messages complete as NOT_SUPPORTED).
+ * Uses io_uring on Linux (LOGGER_USE_IO_URING) and a writer thread otherwise.
+ *
+ * The buffers are allocated and the file is opened on the first send() or flush(), i.e. by
+ * the consuming thread, so MemoryPolicy::CURRENT_NODE places them on the consumer's NUMA node.
+ * Write errors are counted and reported to the handler (see IoErrors) on the thread completing
+ * the write: the writer thread, or the consuming thread with io_uring.
+ */
+class AsyncFileSink : public Sink
+{
+public:
+  static const std::size_t DEFAULT_BUFFER_SIZE = 1024 * 1024;
+  static const std::size_t DEFAULT_BUFFER_COUNT = 4;
+
+  AsyncFileSink(const std::string& aName, Formatter _formatter,
+                std::size_t aBufferSize = DEFAULT_BUFFER_SIZE, std::size_t aBufferCount = DEFAULT_BUFFER_COUNT,
+                const MemoryPolicy& aMemoryPolicy = MemoryPolicy(),
+                DefaultClock::duration aMaxBufferDelay = std::chrono::milliseconds(100))
+    :
+    name(aName),
+    formatter(_formatter),
+    bufferSize(aBufferSize),
+    bufferCount(aBufferCount < 2 ? 2 : aBufferCount),
+    memoryPolicy(aMemoryPolicy),
+    maxBufferDelay(aMaxBufferDelay),
+    offset(0),
+    current(0),
+    used(0)
+  {
+  }
+
+  virtual ~AsyncFileSink()
+  {
+    if (writer)
+    {
+      submitCurrent();
+      writer.reset(); // waits for all pending writes
+    }
+  }
+
+  virtual void send(std::unique_ptr<Message> message) override
+  {
+    openIfNeeded();
+    append(formatter(*message));
+    if (message->commit)
+    {
+      submitCurrent();
+    }
+  }
+
+  virtual void sendFormatted(const std::string& text, std::vector< std::unique_ptr< Message > >& messages) override
+  {
+    openIfNeeded();
+    append(text);
+    for (const auto& message : messages)
+    {
+      if (message->commit)
+      {
+        submitCurrent();
+        break;
+      }
+    }
+  }
+
+  /* hands the current buffer to the writer if it is open for long enough and collects finished buffers,
+   * does not wait for the disk
+   */
+  virtual void flush() override
+  {
+    openIfNeeded();
+    if (used && DefaultClock::now() - bufferOpened >= maxBufferDelay)
+    {
+      submitCurrent();
+    }
+    collect(false);
+  }
+
+  /* hands the current buffer to the writer, the writes complete on destruction */
+  virtual std::uint64_t drain(DefaultClock::time_point /*deadline*/) override
+  {
+    if (writer)
+    {
+      submitCurrent();
+      collect(false);
+    }
+    return 0;
+  }
+
+  /* set it before the sink is used */
+  void setErrorHandler(IoErrors::Handler handler)
+  {
+    errorHandler = std::move(handler);
+  }
+
+  std::uint64_t getErrorCount() const
+  {
+    return writer ? writer->getErrorCount() : 0;
+  }
+
+  /* the buffer being filled; buffers already handed to the writer are not covered */
+  virtual void emergencyWrite(int fd) override
+  {
+    if (current != bufferCount)
+    {
+      writeRaw(fd, buffer(current), used);
+    }
+  }
+
+private:
+  const std::string name;
+  Formatter formatter;
+  const std::size_t bufferSize;
+  const std::size_t bufferCount;
+  const MemoryPolicy memoryPolicy;
+  const DefaultClock::duration maxBufferDelay;
+  MemoryBlock pool;
+  std::unique_ptr< AsyncFileWriter > writer; // nullptr until the first use
+  IoErrors::Handler errorHandler;            // given to the writer
+
+  std::uint64_t offset;   // file offset of the current buffer
+  std::size_t current;    // index of the buffer being filled, bufferCount if none
+  std::size_t used;       // bytes used in the current buffer
+  DefaultClock::time_point bufferOpened; // when the first bytes were put into the current buffer
+  std::vector< std::size_t > freeBuffers;
+
+  void openIfNeeded()
+  {
+    if (writer)
+    {
+      return;
+    }
+
+    pool = MemoryBlock(bufferSize * bufferCount, memoryPolicy);
+    writer = makeWriter();
+    writer->setErrorHandler(errorHandler);
+    for (std::size_t i = 1; i < bufferCount; ++i)
+    {
+      freeBuffers.push_back(i);
+    }
+  }
+
+  std::unique_ptr< AsyncFileWriter > makeWriter()
+  {
+#ifdef LOGGER_USE_IO_URING
+    try
+    {
+      return std::make_unique< UringFileWriter >(name, pool.get(), bufferSize, bufferCount);
+    }
+    catch (const std::runtime_error&)
+    {
+      // io_uring not permitted or not supported by the kernel
+    }
+#endif
+    return std::make_unique< ThreadFileWriter >(name);
+  }
+
+  char* buffer(std::size_t index) const
+  {
+    return pool.get() + index * bufferSize;
+  }
+
+  void append(const std::string& text)
+  {
+    const char* data = text.data();
+    std::size_t size = text.size();
+    while (size)
+    {
+      if (current == bufferCount)
+      {
+        acquireBuffer();
+      }
+      if (used == 0)
+      {
+        bufferOpened = DefaultClock::now();
+      }
+
+      const std::size_t chunk = std::min(size, bufferSize - used);
+      std::memcpy(buffer(current) + used, data, chunk);
+      used += chunk;
+      data += chunk;
+      size -= chunk;
+
+      if (used == bufferSize)
+      {
+        submitCurrent();
+      }
+    }
+  }
+
+  void submitCurrent()
+  {
+    if (current == bufferCount || used == 0)
+    {
+      return;
+    }
+
+    writer->submit(current, buffer(current), used, offset);
+    offset += used;
+    current = bufferCount;
+    used = 0;
+  }
+
+  void acquireBuffer()
+  {
+    if (freeBuffers.empty())
+    {
+      collect(false);
+    }
+    while (freeBuffers.empty())
+    {
+      collect(true);
+    }
+    current = freeBuffers.back();
+    freeBuffers.pop_back();
+  }
+
+  void collect(bool wait)
+  {
+    writer->reap(wait, freeBuffers);
+  }
+};
+
+} // details
+} // logger
@@ -0,0 +1,473 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "logger/details/IoErrors.hpp"
+
+#ifdef LOGGER_USE_IO_URING
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// <linux/fs.h> (included by io_uring.h) defines BLOCK_SIZE, which clashes with ConcurrentQueue traits
+#undef BLOCK_SIZE
+#endif
+
+namespace logger
+{
+namespace details
+{
+
+/* Backend of AsyncFileSink: writes whole buffers of a fixed pool without blocking the caller.
+ * Buffers are identified by their index in the pool; a buffer can be reused by the sink
+ * only after the writer reported it as completed.
+ * Failed writes are reported through IoErrors, on the thread completing them.
+ */
+class AsyncFileWriter
+{
+public:
+  explicit AsyncFileWriter(const std::string& name)
+    :
+    errors(name)
+  {
+  }
+
+  virtual ~AsyncFileWriter() = default;
+
+  virtual void submit(std::size_t buffer, const char* data, std::size_t size, std::uint64_t offset) = 0;
+
+  /* appends indices of the finished buffers to `completed`
+   * if `wait` is set, blocks until at least one buffer is finished (unless nothing is in flight)
+   */
+  virtual void reap(bool wait, std::vector< std::size_t >& completed) = 0;
+
+  /* set it before the first submit() */
+  void setErrorHandler(IoErrors::Handler handler)
+  {
+    errors.setHandler(std::move(handler));
+  }
+
+  std::uint64_t getErrorCount() const
+  {
+    return errors.getCount();
+  }
+
+protected:
+  IoErrors errors;
+};
+
+/* portable fallback: a background thread performing ordered blocking writes */
+class ThreadFileWriter : public AsyncFileWriter
+{
+public:
+  explicit ThreadFileWriter(const std::string& name)
+    :
+    AsyncFileWriter(name),
+    doBreak(false),
+    inFlight(0)
+  {
+    file.rdbuf()->pubsetbuf(nullptr, 0); // buffers are already large, avoid a second copy
+    file.open(name, std::ofstream::out | std::ofstream::binary);
+    thread = std::thread([this]() { work(); });
+  }
+
+  virtual ~ThreadFileWriter()
+  {
+    {
+      std::lock_guard< std::mutex > lock(mt);
+      doBreak = true;
+    }
+    wakeWriter.notify_one();
+    thread.join();
+  }
+
+  /* the writes are ordered, the offset is implied */
+  virtual void submit(std::size_t buffer, const char* data, std::size_t size, std::uint64_t /*offset*/) override
+  {
+    {
+      std::lock_guard< std::mutex > lock(mt);
+      jobs.push_back(Job{ buffer, data, size });
+      ++inFlight;
+    }
+    wakeWriter.notify_one();
+  }
+
+  virtual void reap(bool wait, std::vector< std::size_t >& completed) override
+  {
+    std::unique_lock< std::mutex > lock(mt);
+    if (wait)
+    {
+      wakeReaper.wait(lock, [this]() { return !finished.empty() || inFlight == 0; });
+    }
+    completed.insert(completed.end(), finished.begin(), finished.end());
+    finished.clear();
+  }
+
+private:
+  struct Job
+  {
+    std::size_t buffer;
+    const char* data;
+    std::size_t size;
+  };
+
+  std::ofstream file;
+  std::thread thread;
+
+  std::mutex mt;
+  std::condition_variable wakeWriter;
+  std::condition_variable wakeReaper;
+  bool doBreak;
+  std::size_t inFlight;
+  std::deque< Job > jobs;
+  std::vector< std::size_t > finished;
+
+  void work()
+  {
+    std::unique_lock< std::mutex > lock(mt);
+    while (true)
+    {
+      wakeWriter.wait(lock, [this]() { return doBreak || !jobs.empty(); });
+      if (jobs.empty())
+      {
+        break; // doBreak is set and everything is written
+      }
+
+      auto job = jobs.front();
+      jobs.pop_front();
+      lock.unlock();
+
+      file.write(job.data, job.size);
+      file.flush();
+
+      lock.lock();
+      errors.checkFlush(file);
+      finished.push_back(job.buffer);
+      --inFlight;
+      wakeReaper.notify_one();
+    }
+  }
+};
+
+#ifdef LOGGER_USE_IO_URING
+
+/* io_uring backend (raw system calls, no liburing dependency)
+ * The buffer pool is registered as fixed buffers, so the kernel does not have to map
+ * the pages on every write. Falls back to regular writes if registration is refused
+ * (e.g. RLIMIT_MEMLOCK), when the kernel supports them (5.6, otherwise the constructor throws).
+ * Short writes are resubmitted. A submission refused for a while (EAGAIN, EBUSY: the completion
+ * queue is full) is retried after reaping, on other errors the queued writes fail.
+ */
+class UringFileWriter : public AsyncFileWriter
+{
+public:
+  /* throws std::runtime_error when io_uring is not available (old kernel, seccomp...) */
+  UringFileWriter(const std::string& name, char* pool, std::size_t bufferSize, std::size_t bufferCount)
+    :
+    AsyncFileWriter(name),
+    pending(bufferCount)
+  {
+    fd = ::open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1)
+    {
+      throw std::runtime_error("UringFileWriter: cannot open " + name);
+    }
+
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    unsigned entries = 1;
+    while (entries < bufferCount * 2)
+    {
+      entries <<= 1;
+    }
+
+    ringFd = static_cast< int >(syscall(__NR_io_uring_setup, entries, &params));
+    if (ringFd < 0)
+    {
+      ::close(fd);
+      throw std::runtime_error("UringFileWriter: io_uring_setup failed");
+    }
+    mapRings(params);
+
+    std::vector< iovec > iovecs(bufferCount);
+    for (std::size_t i = 0; i < bufferCount; ++i)
+    {
+      iovecs[i].iov_base = pool + i * bufferSize;
+      iovecs[i].iov_len = bufferSize;
+    }
+    fixedBuffers = syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_BUFFERS, iovecs.data(), static_cast< unsigned >(bufferCount)) == 0;
+    if (!fixedBuffers && !supports(IORING_OP_WRITE))
+    {
+      // its writes would complete with -EINVAL
+      unmapRings();
+      ::close(ringFd);
+      ::close(fd);
+      throw std::runtime_error("UringFileWriter: IORING_OP_WRITE not supported");
+    }
+  }
+
+  virtual ~UringFileWriter()
+  {
+    std::vector< std::size_t > completed;
+    while (inFlight)
+    {
+      reap(true, completed);
+    }
+    unmapRings();
+    ::close(ringFd);
+    ::close(fd);
+  }
+
+  virtual void submit(std::size_t buffer, const char* data, std::size_t size, std::uint64_t offset) override
+  {
+    pending[buffer] = Pending{ data, size, offset };
+    ++inFlight;
+    push(buffer);
+    enter(0); // if refused, the write stays queued for reap()
+  }
+
+  virtual void reap(bool wait, std::vector< std::size_t >& completed) override
+  {
+    const auto found = completed.size();
+    for (;;)
+    {
+      const bool waiting = wait && inFlight && completed.size() == found && failed.empty() && !hasCompletions();
+      const bool refused = (isQueued() || waiting) && !enter(waiting ? 1 : 0);
+
+      completed.insert(completed.end(), failed.begin(), failed.end());
+      failed.clear();
+      const bool reaped = collect(completed);
+
+      if (!isQueued() && (!wait || !inFlight || completed.size() != found))
+      {
+        return;
+      }
+      if (refused && !reaped)
+      {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+private:
+  struct Pending
+  {
+    const char* data;
+    std::size_t size;
+    std::uint64_t offset;
+  };
+
+  int fd = -1;
+  int ringFd = -1;
+  bool fixedBuffers = false;
+  std::size_t inFlight = 0;
+  std::vector< Pending > pending;
+  std::vector< std::size_t > failed; // buffers whose submission failed, returned by reap()
+
+  void* sqRing = nullptr;
+  void* cqRing = nullptr;
+  std::size_t sqRingSize = 0;
+  std::size_t cqRingSize = 0;
+  std::size_t sqesSize = 0;
+
+  unsigned* sqHead = nullptr;
+  unsigned* sqTail = nullptr;
+  unsigned* sqMask = nullptr;
+  unsigned* sqArray = nullptr;
+  io_uring_sqe* sqes = nullptr;
+
+  unsigned* cqHead = nullptr;
+  unsigned* cqTail = nullptr;
+  unsigned* cqMask = nullptr;
+  io_uring_cqe* cqes = nullptr;
+
+  /* handles the completions, short and interrupted writes are queued again; returns whether there were any */
+  bool collect(std::vector< std::size_t >& completed)
+  {
+    unsigned head = *cqHead;
+    const unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head)
+    {
+      const io_uring_cqe& cqe = cqes[head & *cqMask];
+      const auto buffer = static_cast< std::size_t >(cqe.user_data);
+      auto& job = pending[buffer];
+
+      if (cqe.res == -EINTR || cqe.res == -EAGAIN)
+      {
+        push(buffer);
+        continue;
+      }
+      if (cqe.res > 0 && static_cast< std::size_t >(cqe.res) < job.size)
+      {
+        job.data += cqe.res;
+        job.size -= cqe.res;
+        job.offset += cqe.res;
+        push(buffer);
+        continue;
+      }
+
+      errors.checkCompleted(cqe.res < 0 ? -cqe.res : 0);
+      --inFlight;
+      completed.push_back(buffer);
+    }
+    const bool any = head != *cqHead;
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    return any;
+  }
+
+  void mapRings(const io_uring_params& params)
+  {
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap)
+    {
+      sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+    }
+
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    cqRing = singleMap ? sqRing : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast< io_uring_sqe* >(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+    if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED)
+    {
+      unmapRings();
+      ::close(ringFd);
+      ::close(fd);
+      throw std::runtime_error("UringFileWriter: cannot map the rings");
+    }
+
+    auto sq = static_cast< char* >(sqRing);
+    sqHead = reinterpret_cast< unsigned* >(sq + params.sq_off.head);
+    sqTail = reinterpret_cast< unsigned* >(sq + params.sq_off.tail);
+    sqMask = reinterpret_cast< unsigned* >(sq + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast< unsigned* >(sq + params.sq_off.array);
+
+    auto cq = static_cast< char* >(cqRing);
+    cqHead = reinterpret_cast< unsigned* >(cq + params.cq_off.head);
+    cqTail = reinterpret_cast< unsigned* >(cq + params.cq_off.tail);
+    cqMask = reinterpret_cast< unsigned* >(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast< io_uring_cqe* >(cq + params.cq_off.cqes);
+  }
+
+  /* the mappings which succeeded */
+  void unmapRings()
+  {
+    if (sqes != MAP_FAILED)
+    {
+      munmap(sqes, sqesSize);
+    }
+    if (cqRing != sqRing && cqRing != MAP_FAILED)
+    {
+      munmap(cqRing, cqRingSize);
+    }
+    if (sqRing != MAP_FAILED)
+    {
+      munmap(sqRing, sqRingSize);
+    }
+  }
+
+  /* the probe came with IORING_OP_WRITE (Linux 5.6), older kernels refuse both */
+  bool supports(unsigned opcode) const
+  {
+    const unsigned OP_COUNT = 256;
+    std::vector< char > memory(sizeof(io_uring_probe) + OP_COUNT * sizeof(io_uring_probe_op)); // zeroed, as required
+    auto probe = reinterpret_cast< io_uring_probe* >(memory.data());
+    if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PROBE, probe, OP_COUNT) != 0)
+    {
+      return false;
+    }
+    return opcode <= probe->last_op && (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED) != 0;
+  }
+
+  /* whether some writes were not consumed by the kernel yet */
+  bool isQueued() const
+  {
+    return *sqTail != __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+  }
+
+  bool hasCompletions() const
+  {
+    return *cqHead != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+  }
+
+  /* queues a write of the pending part of the buffer (only this thread touches the SQ tail) */
+  void push(std::size_t buffer)
+  {
+    const auto& job = pending[buffer];
+    const unsigned tail = *sqTail;
+    const unsigned index = tail & *sqMask;
+
+    io_uring_sqe& sqe = sqes[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = fixedBuffers ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast< std::uint64_t >(job.data);
+    sqe.len = static_cast< unsigned >(job.size);
+    sqe.off = job.offset;
+    sqe.buf_index = static_cast< std::uint16_t >(buffer);
+    sqe.user_data = buffer;
+
+    sqArray[index] = index;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+  }
+
+  /* submits the queued writes and waits for `minComplete` completions, returns false if it failed:
+   * refused for now (EAGAIN, EBUSY), the writes stay queued; on other errors the queued writes fail,
+   * so none of them stays in flight forever (the submitted ones still complete, reap() polls for them)
+   */
+  bool enter(unsigned minComplete)
+  {
+    const unsigned flags = minComplete ? IORING_ENTER_GETEVENTS : 0;
+    for (;;)
+    {
+      const unsigned toSubmit = *sqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+      if (syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0) >= 0)
+      {
+        return true;
+      }
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EBUSY)
+      {
+        return false;
+      }
+      failQueued(errno);
+      return false;
+    }
+  }
+
+  /* takes back the writes not consumed by the kernel (it reads the SQ tail only when entered) */
+  void failQueued(int error)
+  {
+    const unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    for (unsigned entry = head; entry != *sqTail; ++entry)
+    {
+      failed.push_back(static_cast< std::size_t >(sqes[entry & *sqMask].user_data));
+      errors.checkCompleted(error);
+      --inFlight;
+    }
+    __atomic_store_n(sqTail, head, __ATOMIC_RELEASE);
+  }
+};
+
+#endif // LOGGER_USE_IO_URING
+
+} // details
+} // logger
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "logger/Sink.hpp"
+
+#include "logger/details/EmergencyFlush.hpp"
+
+namespace logger
+{
+namespace details
+{
+
+/* Collects messages in per-thread staging buffers and publishes them to the shared
+ * (multithread) sink in bulk, so the queue/mutex of the shared sink is touched once
+ * per batch instead of once per message.
+ *
+ * A thread's buffer is published when:
+ *  - it holds `maxMessages` messages,
+ *  - its oldest message is older than `maxDelay` (checked on send and by flush() of any thread),
+ *  - the thread calls flush() (e.g. Logger's autoFlushLevel) or publish().
+ * Registered in EmergencyFlush on its own, after the sink behind it (created first), so on
+ * a crash the staged messages are written after the ones already published.
+ */
+class BatchingSink : public Sink
+{
+public:
+  typedef std::vector< std::unique_ptr< Message > > Messages;
+
+  explicit BatchingSink(std::shared_ptr< Sink > aSink, std::size_t aMaxMessages = 64,
+    DefaultClock::duration aMaxDelay = std::chrono::milliseconds(10))
+    :
+    internalSink(aSink),
+    maxMessages(aMaxMessages),
+    maxDelay(aMaxDelay),
+    id(nextId()++)
+  {
+    EmergencyFlush::instance().add(this);
+  }
+
+  virtual ~BatchingSink()
+  {
+    EmergencyFlush::instance().remove(this);
+    publishAll();
+  }
+
+  virtual void send(std::unique_ptr<Message> message) override
+  {
+    auto& staging = getStaging();
+    std::lock_guard< std::mutex > lock(staging.mt); // uncontended, except for a concurrent flush()
+
+    const auto now = message->time.time_since_epoch().count();
+    if (staging.messages.empty())
+    {
+      staging.firstTime.store(now, std::memory_order_relaxed);
+    }
+    staging.messages.push_back(std::move(message));
+
+    if (staging.messages.size() >= maxMessages || now - staging.firstTime.load(std::memory_order_relaxed) >= maxDelay.count())
+    {
+      publish(staging);
+    }
+  }
+
+  virtual void sendBulk(Messages& messages) override
+  {
+    auto& staging = getStaging();
+    std::lock_guard< std::mutex > lock(staging.mt);
+    publish(staging); // keeps the order of the thread's messages
+    internalSink->sendBulk(messages);
+  }
+
+  /* publishes the calling thread's buffer and every expired buffer, then flushes the internal sink */
+  virtual void flush() override
+  {
+    publish();
+
+    const auto deadline = (DefaultClock::now() - maxDelay).time_since_epoch().count();
+    {
+      std::lock_guard< std::mutex > lock(stagingsMt);
+      for (auto it = stagings.begin(); it != stagings.end();)
+      {
+        auto& staging = **it;
+        const auto firstTime = staging.firstTime.load(std::memory_order_relaxed);
+        if (firstTime != EMPTY && firstTime <= deadline)
+        {
+          std::lock_guard< std::mutex > stagingLock(staging.mt);
+          publish(staging);
+        }
+
+        // the owning thread has exited and nothing is left to publish
+        if (it->use_count() == 1 && staging.firstTime.load(std::memory_order_relaxed) == EMPTY)
+        {
+          it = stagings.erase(it);
+        }
+        else
+        {
+          ++it;
+        }
+      }
+    }
+
+    internalSink->flush();
+  }
+
+  /* staged messages are published before the internal sink stops accepting them */
+  virtual void close() override
+  {
+    publishAll();
+    internalSink->close();
+  }
+
+  virtual std::uint64_t drain(DefaultClock::time_point deadline) override
+  {
+    publishAll();
+    return internalSink->drain(deadline);
+  }
+
+  /* the queue behind, staged messages are bounded by maxMessages per thread */
+  virtual Backlog getBacklog() override
+  {
+    return internalSink->getBacklog();
+  }
+
+  /* the staged messages only, the sink behind is registered itself; a locked buffer is skipped */
+  virtual void emergencyWrite(int fd) override
+  {
+    if (!stagingsMt.try_lock())
+    {
+      return;
+    }
+    for (auto& staging : stagings)
+    {
+      if (staging->mt.try_lock())
+      {
+        for (const auto& message : staging->messages)
+        {
+          writeRawMessage(fd, *message);
+        }
+        staging->mt.unlock();
+      }
+    }
+    stagingsMt.unlock();
+  }
+
+  /* publishes the calling thread's buffer without flushing */
+  void publish()
+  {
+    auto& staging = getStaging();
+    std::lock_guard< std::mutex > lock(staging.mt);
+    publish(staging);
+  }
+
+private:
+  static const DefaultClock::rep EMPTY = 0;
+
+  struct Staging
+  {
+    Staging()
+      :
+      firstTime(EMPTY)
+    {
+    }
+
+    std::mutex mt;
+    Messages messages;
+    std::atomic< DefaultClock::rep > firstTime; // time of the oldest message, EMPTY when there is none
+  };
+
+  typedef std::shared_ptr< Staging > StagingPtr;
+
+  std::shared_ptr< Sink > internalSink;
+  const std::size_t maxMessages;
+  const DefaultClock::duration maxDelay;
+  const std::uint64_t id; // unique for the process lifetime, unlike `this`
+
+  std::mutex stagingsMt;
+  std::vector< StagingPtr > stagings; // buffers of all threads, also the ones which have exited
+
+  static std::atomic< std::uint64_t >& nextId()
+  {
+    static std::atomic< std::uint64_t > counter(1);
+    return counter;
+  }
+
+  void publishAll()
+  {
+    std::lock_guard< std::mutex > lock(stagingsMt);
+    for (auto& staging : stagings)
+    {
+      std::lock_guard< std::mutex > stagingLock(staging->mt);
+      publish(*staging);
+    }
+  }
+
+  /* Staging must be locked */
+  void publish(Staging& staging)
+  {
+    if (staging.messages.empty())
+    {
+      return;
+    }
+    internalSink->sendBulk(staging.messages);
+    staging.messages.clear();
+    staging.firstTime.store(EMPTY, std::memory_order_relaxed);
+  }
+
+  /* the thread's buffer, created and registered on first use
+   * entries of destroyed sinks stay in the thread's map until the thread exits
+   */
+  Staging& getStaging()
+  {
+    thread_local std::uint64_t lastId = 0;
+    thread_local Staging* lastStaging = nullptr;
+    if (lastId == id)
+    {
+      return *lastStaging;
+    }
+
+    thread_local std::unordered_map< std::uint64_t, StagingPtr > threadStagings;
+    auto& staging = threadStagings[id];
+    if (!staging)
+    {
+      staging = std::make_shared< Staging >();
+      staging->messages.reserve(maxMessages);
+      std::lock_guard< std::mutex > lock(stagingsMt);
+      stagings.push_back(staging);
+    }
+
+    lastId = id;
+    lastStaging = staging.get();
+    return *staging;
+  }
+};
+
+} // details
+} // logger
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_set>
+
+#include "logger/Message.hpp"
+
+namespace logger
+{
+namespace details
+{
+
+/* Compact, unformatted representation of a Message:
+ * a fixed header followed by the logger name, function, file, content and structured fields bytes.
+ * Records are only exchanged between processes on the same host (native byte order), the thread id
+ * is carried as its bytes: it identifies the producer's thread within its process.
+ */
+struct BinaryRecordHeader
+{
+  std::int64_t time;        // DefaultClock ticks since epoch
+  std::uint64_t threadId;   // std::thread::id bytes
+  std::uint32_t level;
+  std::uint32_t line;
+  std::uint32_t loggerSize;
+  std::uint32_t functionSize;
+  std::uint32_t fileSize;
+  std::uint32_t contentSize;
+  std::uint32_t fieldsSize;
+  std::uint32_t reserved;
+};
+
+static_assert(sizeof(std::thread::id) <= sizeof(std::uint64_t) && std::is_trivially_copyable< std::thread::id >::value,
+  "std::thread::id has to fit BinaryRecordHeader::threadId");
+
+struct BinaryRecordView
+{
+  BinaryRecordHeader header;
+  const char* logger;
+  const char* function;
+  const char* file;
+  const char* content;
+  const char* fields;
+};
+
+inline std::size_t binaryRecordSize(const Message& message)
+{
+  return sizeof(BinaryRecordHeader)
+    + message.loggerContext->name.size()
+    + std::strlen(message.callContext.function)
+    + std::strlen(message.callContext.file)
+    + message.content.size()
+    + message.fields.size();
+}
+
+/* writes the record into the buffer, which has to have at least binaryRecordSize(message) bytes
+ * returns the number of written bytes
+ */
+inline std::size_t encodeBinaryRecord(const Message& message, char* buffer)
+{
+  const auto& loggerName = message.loggerContext->name;
+
+  BinaryRecordHeader header;
+  header.time = message.time.time_since_epoch().count();
+  header.threadId = 0;
+  std::memcpy(&header.threadId, &message.threadId, sizeof(message.threadId));
+  header.level = static_cast< std::uint32_t >(message.level);
+  header.line = message.callContext.line;
+  header.loggerSize = static_cast< std::uint32_t >(loggerName.size());
+  header.functionSize = static_cast< std::uint32_t >(std::strlen(message.callContext.function));
+  header.fileSize = static_cast< std::uint32_t >(std::strlen(message.callContext.file));
+  header.contentSize = static_cast< std::uint32_t >(message.content.size());
+  header.fieldsSize = static_cast< std::uint32_t >(message.fields.size());
+  header.reserved = 0;
+
+  char* out = buffer;
+  std::memcpy(out, &header, sizeof(header));
+  out += sizeof(header);
+  std::memcpy(out, loggerName.data(), header.loggerSize);
+  out += header.loggerSize;
+  std::memcpy(out, message.callContext.function, header.functionSize);
+  out += header.functionSize;
+  std::memcpy(out, message.callContext.file, header.fileSize);
+  out += header.fileSize;
+  std::memcpy(out, message.content.data(), header.contentSize);
+  out += header.contentSize;
+  std::memcpy(out, message.fields.data(), header.fieldsSize);
+  out += header.fieldsSize;
+
+  return out - buffer;
+}
+
+/* returns false if the buffer does not contain a complete record
+ * the view points into the buffer, no string is copied
+ */
+inline bool decodeBinaryRecord(const char* buffer, std::size_t size, BinaryRecordView& record)
+{
+  if (size < sizeof(BinaryRecordHeader))
+  {
+    return false;
+  }
+  std::memcpy(&record.header, buffer, sizeof(BinaryRecordHeader));
+
+  const auto& header = record.header;
+  const std::uint64_t payloadSize = std::uint64_t(header.loggerSize) + header.functionSize + header.fileSize + header.contentSize
+    + header.fieldsSize;
+  if (payloadSize > size - sizeof(BinaryRecordHeader))
+  {
+    return false;
+  }
+
+  record.logger = buffer + sizeof(BinaryRecordHeader);
+  record.function = record.logger + header.loggerSize;
+  record.file = record.function + header.functionSize;
+  record.content = record.file + header.fileSize;
+  record.fields = record.content + header.contentSize;
+  return true;
+}
+
+/* Formatter producing length prefixed records: [uint32 record size][record]
+ * for stream or datagram transports carrying unformatted messages
+ */
+class BinaryRecordFormatter
+{
+public:
+  std::string operator()(const Message& message) const
+  {
+    const auto size = static_cast< std::uint32_t >(binaryRecordSize(message));
+    std::string result(sizeof(size) + size, '\0');
+    std::memcpy(&result[0], &size, sizeof(size));
+    encodeBinaryRecord(message, &result[sizeof(size)]);
+    return result;
+  }
+};
+
+/* Turns decoded records back into Messages, so a normal Sink/Formatter can be used
+ * on the receiving side.
+ * CallContext keeps raw pointers, so function and file names are interned for
+ * the lifetime of the rebuilder.
+ */
+class MessageRebuilder
+{
+public:
+  std::unique_ptr< Message > rebuild(const BinaryRecordView& record)
+  {
+    const auto& header = record.header;
+
+    const char* function = intern(record.function, header.functionSize);
+    CallContext callContext(function, function, intern(record.file, header.fileSize), header.line);
+
+    auto& loggerContext = getLoggerContext(std::string(record.logger, header.loggerSize));
+
+    auto message = std::make_unique< Message >(callContext, loggerContext);
+    message->level = static_cast< Level >(header.level);
+    message->content.assign(record.content, header.contentSize);
+    message->fields.assign(record.fields, header.fieldsSize);
+    std::memcpy(static_cast< void* >(&message->threadId), &header.threadId, sizeof(message->threadId));
+    message->time = std::chrono::time_point< DefaultClock >(DefaultClock::duration(header.time));
+    return message;
+  }
+
+private:
+  std::unordered_set< std::string > strings; // nodes are stable, so c_str() pointers stay valid
+  std::map< std::string, std::shared_ptr< const LoggerContext > > loggers;
+
+  const char* intern(const char* text, std::size_t size)
+  {
+    return strings.emplace(text, size).first->c_str();
+  }
+
+  std::shared_ptr< const LoggerContext >& getLoggerContext(const std::string& name)
+  {
+    auto& result = loggers[name];
+    if (!result)
+    {
+      result = std::make_shared< LoggerContext >(name);
+    }
+    return result;
+  }
+};
+
+} // details
+} // logger
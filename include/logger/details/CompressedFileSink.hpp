@@ -0,0 +1,281 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "logger/Sink.hpp"
+#include "logger/Formatter.hpp"
+
+#include "logger/details/EmergencyFlush.hpp"
+#include "logger/details/FileIndex.hpp"
+#include "logger/details/GroupCommit.hpp"
+#include "logger/details/IoErrors.hpp"
+#include "logger/details/Lz4.hpp"
+
+namespace logger
+{
+namespace details
+{
+
+enum class FrameCodec : std::uint32_t
+{
+  STORED = 0, // compression did not help
+  LZ4 = 1
+};
+
+/* every frame of a CompressedFileSink file starts with it, followed by `storedSize` bytes */
+struct FrameHeader
+{
+  char magic[4];             // "LGFR"
+  FrameCodec codec;
+  std::uint32_t storedSize;
+  std::uint32_t rawSize;
+};
+
+/* returns false if the frame is malformed */
+inline bool decodeFrame(const FrameHeader& header, const char* data, std::string& text)
+{
+  if (std::memcmp(header.magic, "LGFR", sizeof(header.magic)) != 0)
+  {
+    return false;
+  }
+  text.resize(header.rawSize);
+  if (header.codec == FrameCodec::STORED)
+  {
+    if (header.storedSize != header.rawSize)
+    {
+      return false;
+    }
+    std::memcpy(&text[0], data, header.rawSize);
+    return true;
+  }
+  return header.codec == FrameCodec::LZ4
+    && lz4::decompress(data, header.storedSize, &text[0], text.size()) == header.rawSize;
+}
+
+enum class FrameRead
+{
+  OK,
+  END,      // no complete header at the offset
+  MALFORMED // or not written completely yet
+};
+
+/* reads and decodes the frame at the offset of a file, `next` - offset of the following one,
+ * `buffer` - for the stored data, reused between calls
+ */
+inline FrameRead readFrame(std::istream& file, std::uint64_t offset, std::uint64_t& next, std::vector< char >& buffer, std::string& text)
+{
+  FrameHeader header;
+  file.clear();
+  file.seekg(offset);
+  if (!file.read(reinterpret_cast< char* >(&header), sizeof(header)))
+  {
+    return FrameRead::END;
+  }
+
+  buffer.resize(header.storedSize);
+  if (!file.read(buffer.data(), buffer.size()) || !decodeFrame(header, buffer.data(), text))
+  {
+    return FrameRead::MALFORMED;
+  }
+  next = offset + sizeof(header) + header.storedSize;
+  return FrameRead::OK;
+}
+
+/* FileSink writing LZ4 compressed frames of about `frameSize` formatted bytes,
+ * with a sidecar index (see FileIndex.hpp) of each frame's offset, time range and levels,
+ * so a reader (see src/reader) decompresses only the frames it needs.
+ *
+ * A frame is written when it is full, when flush() is called after it has been open for
+ * `maxFrameDelay` (the registry's flushing thread calls flush() continuously) and on destruction.
+ * A pending group commit of durable messages (see GroupCommit) closes the frame early, in flush()
+ * or, when it is due on write, in send().
+ * A written frame is flushed to the OS at once, so on a crash only the open frame is pending
+ * (written as text by emergencyWrite).
+ */
+class CompressedFileSink : public Sink
+{
+public:
+  static const std::size_t DEFAULT_FRAME_SIZE = 1024 * 1024;
+
+  CompressedFileSink(const std::string& name, Formatter _formatter, std::size_t aFrameSize = DEFAULT_FRAME_SIZE,
+    DefaultClock::duration aMaxFrameDelay = std::chrono::seconds(1))
+    :
+    formatter(_formatter),
+    frameSize(aFrameSize),
+    maxFrameDelay(aMaxFrameDelay),
+    file(name, std::ofstream::out | std::ofstream::binary),
+    index(name, FileLayout::FRAMES),
+    offset(0),
+    errors(name)
+  {
+    commits.open(name);
+    frame.reserve(frameSize + frameSize / 8);
+    compressed.resize(lz4::compressBound(frame.capacity()));
+  }
+
+  virtual ~CompressedFileSink()
+  {
+    writeFrame();
+    file.flush();
+    errors.checkFlush(file);
+    commits.commit(!errors.takeFailed());
+    index.flush();
+  }
+
+  virtual void send(std::unique_ptr<Message> message) override
+  {
+    indexMessage(*message);
+    frame += formatter(*message);
+    commits.add(*message);
+    written();
+  }
+
+  virtual void sendFormatted(const std::string& text, std::vector< std::unique_ptr< Message > >& messages) override
+  {
+    for (const auto& message : messages)
+    {
+      indexMessage(*message);
+    }
+    frame += text;
+    for (const auto& message : messages)
+    {
+      commits.add(*message);
+    }
+    written();
+  }
+
+  virtual void flush() override
+  {
+    const bool commitDue = commits.isDue();
+    if (!index.isChunkEmpty() && (commitDue || DefaultClock::now() - frameOpened >= maxFrameDelay))
+    {
+      writeFrame();
+    }
+    file.flush();
+    errors.checkFlush(file);
+    commits.flushed();
+    if (commitDue)
+    {
+      commits.commit(!errors.takeFailed());
+    }
+    index.flush();
+  }
+
+  /* minimal time between two syncs of durable messages */
+  void setCommitInterval(GroupCommit::Clock::duration interval)
+  {
+    commits.setInterval(interval);
+  }
+
+  /* set it before the sink is used */
+  void setErrorHandler(IoErrors::Handler handler)
+  {
+    errors.setHandler(std::move(handler));
+  }
+
+  std::uint64_t getErrorCount() const
+  {
+    return errors.getCount();
+  }
+
+  /* the formatted text of the open frame */
+  virtual void emergencyWrite(int fd) override
+  {
+    writeRaw(fd, frame.data(), frame.size());
+  }
+
+private:
+  Formatter formatter;
+  const std::size_t frameSize;
+  const DefaultClock::duration maxFrameDelay;
+
+  std::ofstream file;
+  FileIndexWriter index;
+  std::uint64_t offset; // of the next frame
+
+  std::string frame;       // formatted messages of the open frame
+  std::string compressed;
+  DefaultClock::time_point frameOpened;
+
+  GroupCommit commits;
+  IoErrors errors;
+
+  /* before the message's text is added to the frame */
+  void indexMessage(const Message& message)
+  {
+    if (commits.opensGroup(message))
+    {
+      errors.takeFailed(); // an error of earlier writes does not fail the group
+    }
+    if (index.isChunkEmpty())
+    {
+      frameOpened = DefaultClock::now();
+    }
+    index.add(message, offset);
+  }
+
+  /* after text was added to the frame */
+  void written()
+  {
+    if (commits.isDueOnWrite())
+    {
+      writeFrame();
+      file.flush();
+      errors.checkFlush(file);
+      commits.commit(!errors.takeFailed());
+    }
+    else if (frame.size() >= frameSize)
+    {
+      writeFrame();
+    }
+  }
+
+  void writeFrame()
+  {
+    if (index.isChunkEmpty())
+    {
+      return;
+    }
+
+    if (compressed.size() < lz4::compressBound(frame.size()))
+    {
+      compressed.resize(lz4::compressBound(frame.size()));
+    }
+    const auto compressedSize = lz4::compress(frame.data(), frame.size(), &compressed[0]);
+
+    FrameHeader header;
+    std::memcpy(header.magic, "LGFR", sizeof(header.magic));
+    header.rawSize = static_cast< std::uint32_t >(frame.size());
+    const char* data;
+    if (compressedSize < frame.size())
+    {
+      header.codec = FrameCodec::LZ4;
+      header.storedSize = static_cast< std::uint32_t >(compressedSize);
+      data = compressed.data();
+    }
+    else
+    {
+      header.codec = FrameCodec::STORED;
+      header.storedSize = header.rawSize;
+      data = frame.data();
+    }
+
+    file.write(reinterpret_cast< const char* >(&header), sizeof(header));
+    file.write(data, header.storedSize);
+    file.flush();
+    errors.checkWrite(file);
+    offset += sizeof(header) + header.storedSize;
+
+    index.closeChunk(offset);
+    frame.clear();
+  }
+};
+
+} // details
+} // logger
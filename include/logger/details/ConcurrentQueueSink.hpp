@@ -1,11 +1,17 @@
 #pragma once
 
 #include <concurrentqueue.h>
+#include <iterator>
 #include <mutex>
 
 #include "logger/Sink.hpp"
 #include "logger/Formatter.hpp"
 
+#include "logger/details/DuplicateCollapser.hpp"
+#include "logger/details/EmergencyFlush.hpp"
+#include "logger/details/LagMeter.hpp"
+#include "logger/details/OrderedMerger.hpp"
+
 namespace logger
 {
 namespace details
@@ -16,32 +22,191 @@ class ConcurrentQueueSink : public Sink
 public:
   explicit ConcurrentQueueSink(std::shared_ptr< Sink > aSink)
     :
-    internalSink(aSink)
+    internalSink(aSink),
+    closed(false),
+    rejected(0)
+  {
+    EmergencyFlush::instance().add(this);
+  }
+
+  virtual ~ConcurrentQueueSink()
   {
+    EmergencyFlush::instance().remove(this);
+    flush();
+    std::lock_guard< std::timed_mutex > lock(flushMt);
+    merger.releaseAll(makeOutput()); // messages still held back for ordering
+    collapser.flush(*internalSink);
+    internalSink->flush();
   }
 
   virtual void send(std::unique_ptr<Message> message) override
   {
+    if (closed.load(std::memory_order_relaxed))
+    {
+      rejected.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
     messages.enqueue(std::move(message));
   }
 
+  virtual void sendBulk(std::vector< std::unique_ptr< Message > >& bulk) override
+  {
+    if (closed.load(std::memory_order_relaxed))
+    {
+      rejected.fetch_add(bulk.size(), std::memory_order_relaxed);
+      bulk.clear();
+      return;
+    }
+    messages.enqueue_bulk(std::make_move_iterator(bulk.begin()), bulk.size());
+  }
+
+  /* collapses runs of identical messages within the window, zero disables it (default) */
+  void setDuplicateWindow(DefaultClock::duration window)
+  {
+    std::lock_guard< std::timed_mutex > lock(flushMt);
+    collapser.setWindow(window);
+  }
+
+  /* delivers messages of all threads in Message::time order, holding them back for the window
+   * zero disables it (default)
+   */
+  void setOrderedDelivery(DefaultClock::duration window)
+  {
+    std::lock_guard< std::timed_mutex > lock(flushMt);
+    if (!window.count())
+    {
+      merger.releaseAll(makeOutput());
+    }
+    merger.setWindow(window);
+  }
+
   virtual void flush() override
   {
-    std::lock_guard< std::mutex > lock(flushMt);
+    std::lock_guard< std::timed_mutex > lock(flushMt);
 
     std::unique_ptr<Message> message;
-    while (messages.try_dequeue(message))
+    const bool any = messages.try_dequeue(message);
+    if (any)
+    {
+      lag.begin(message->time); // the first one dequeued, approximately the oldest
+    }
+    else
     {
-      internalSink->send(std::move(message));
+      lag.idle();
     }
 
+    if (merger.isEnabled())
+    {
+      for (bool more = any; more; more = messages.try_dequeue(message))
+      {
+        merger.push(std::move(message));
+      }
+      merger.release(makeOutput());
+    }
+    else
+    {
+      for (bool more = any; more; more = messages.try_dequeue(message))
+      {
+        collapser.send(std::move(message), *internalSink);
+      }
+    }
+    collapser.flush(*internalSink);
+
     internalSink->flush();
+    if (any)
+    {
+      lag.end();
+    }
+  }
+
+  virtual Backlog getBacklog() override
+  {
+    Backlog backlog;
+    backlog.messages = messages.size_approx();
+    backlog.lag = lag.get();
+    return backlog;
+  }
+
+  virtual void close() override
+  {
+    closed.store(true);
+    internalSink->close();
+  }
+
+  virtual std::uint64_t drain(DefaultClock::time_point deadline) override
+  {
+    std::unique_lock< std::timed_mutex > lock(flushMt, std::defer_lock);
+    if (!lock.try_lock_until(deadline))
+    {
+      // another flush is stuck, e.g. on a slow disk
+      return messages.size_approx() + rejected.load();
+    }
+
+    std::uint64_t lost = 0;
+    std::unique_ptr<Message> message;
+    for (std::size_t delivered = 0; messages.try_dequeue(message); ++delivered)
+    {
+      if (delivered % DRAIN_CHECK_INTERVAL == 0 && DefaultClock::now() >= deadline)
+      {
+        lost += 1 + messages.size_approx();
+        break;
+      }
+      if (merger.isEnabled())
+      {
+        merger.push(std::move(message));
+      }
+      else
+      {
+        collapser.send(std::move(message), *internalSink);
+      }
+    }
+    merger.releaseAll(makeOutput());
+    collapser.flush(*internalSink);
+
+    lost += internalSink->drain(deadline);
+    return lost + rejected.load();
+  }
+
+  /* Oldest first: the internal sink's buffers, the messages held back by the merger and
+   * the collapser (when no flush is running), the queue; dequeued messages are leaked, not freed.
+   * The message being delivered when the crash came, and the held back ones during a flush, are lost.
+   */
+  virtual void emergencyWrite(int fd) override
+  {
+    internalSink->emergencyWrite(fd);
+    if (flushMt.try_lock())
+    {
+      collapser.emergencyWrite(fd);
+      merger.emergencyWrite(fd);
+      flushMt.unlock();
+    }
+    std::unique_ptr<Message> message;
+    while (messages.try_dequeue(message))
+    {
+      writeRawMessage(fd, *message);
+      message.release();
+    }
   }
 
 private:
+  static const std::size_t DRAIN_CHECK_INTERVAL = 256; // messages delivered between deadline checks
+
   std::shared_ptr< Sink > internalSink;
+  std::atomic< bool > closed;
+  std::atomic< std::uint64_t > rejected; // sent after close()
+
+  std::timed_mutex flushMt; // only one thread can be inside flush() method at the time
+  DuplicateCollapser collapser; // guarded by flushMt
+  OrderedMerger merger;         // guarded by flushMt
+  LagMeter lag;
 
-  std::mutex flushMt; // only one thread can be inside flush() method at the time
+  OrderedMerger::Output makeOutput()
+  {
+    return [this](std::unique_ptr< Message > message)
+    {
+      collapser.send(std::move(message), *internalSink);
+    };
+  }
 
   struct MyTraits : public moodycamel::ConcurrentQueueDefaultTraits
   {
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+
+#include <poll.h>
+#include <unistd.h>
+
+#include "logger/Sink.hpp"
+#include "logger/Formatter.hpp"
+
+#include "logger/details/EmergencyFlush.hpp"
+
+namespace logger
+{
+namespace details
+{
+
+/* what ConsoleSink does when stdout/stderr is a full non-blocking pipe (EAGAIN) */
+enum class ConsoleBlockingPolicy
+{
+  WAIT, // wait up to maxWait for the reader, then behave like DROP
+  DROP  // never wait: keep up to maxPending bytes for the next flush, drop the newest lines beyond it
+};
+
+/* AUTO colours only terminals, and only if NO_COLOR is not set */
+enum class ConsoleColors
+{
+  AUTO,
+  ALWAYS,
+  NEVER
+};
+
+struct ConsoleSinkOptions
+{
+  std::size_t bufferSize = 64 * 1024;  // per descriptor, written when full and on flush()
+  std::size_t maxPending = 1024 * 1024; // unwritten bytes kept while the descriptor is blocked
+  Level errorLevel = Level::WARNING;    // messages at or above go to stderr, the others to stdout
+  ConsoleColors colors = ConsoleColors::AUTO;
+  ConsoleBlockingPolicy blockingPolicy = ConsoleBlockingPolicy::WAIT;
+  std::chrono::milliseconds maxWait = std::chrono::milliseconds(1000);
+};
+
+/* Console sink writing straight to file descriptors 1 and 2, without iostreams.
+ *
+ * Formatted messages are collected in a buffer per descriptor, which is written with write(2)
+ * when it is full and on flush() (the multithread sinks flush after every drained batch), so
+ * a batch costs one system call instead of one per message. Partial writes are continued,
+ * EAGAIN is handled according to the ConsoleBlockingPolicy, a broken descriptor (EPIPE, ...)
+ * drops its output. Lines are coloured by level with ANSI sequences when enabled.
+ */
+class ConsoleSink : public Sink
+{
+public:
+  typedef ConsoleSinkOptions Options;
+
+  explicit ConsoleSink(Formatter _formatter, Options aOptions = Options())
+    :
+    formatter(_formatter),
+    options(aOptions),
+    out(STDOUT_FILENO, useColors(STDOUT_FILENO, aOptions.colors)),
+    err(STDERR_FILENO, useColors(STDERR_FILENO, aOptions.colors)),
+    droppedLines(0),
+    errors(0)
+  {
+    out.buffer.reserve(options.bufferSize);
+    err.buffer.reserve(options.bufferSize);
+  }
+
+  virtual ~ConsoleSink()
+  {
+    flush();
+  }
+
+  virtual void send(std::unique_ptr<Message> message) override
+  {
+    auto& stream = message->level >= options.errorLevel ? err : out;
+    if (stream.colored)
+    {
+      appendColored(stream.buffer, message->level, formatter(*message));
+    }
+    else
+    {
+      stream.buffer += formatter(*message);
+    }
+
+    if (stream.buffer.size() >= options.bufferSize)
+    {
+      write(stream);
+    }
+  }
+
+  virtual void flush() override
+  {
+    write(err);
+    write(out);
+  }
+
+  /* the formatted, not yet written output, to its own descriptors */
+  virtual void emergencyWrite(int) override
+  {
+    writeRaw(err.fd, err.buffer.data(), err.buffer.size());
+    writeRaw(out.fd, out.buffer.data(), out.buffer.size());
+  }
+
+  std::uint64_t getDroppedLineCount() const
+  {
+    return droppedLines.load(std::memory_order_relaxed);
+  }
+
+  std::uint64_t getErrorCount() const
+  {
+    return errors.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Stream
+  {
+    Stream(int aFd, bool aColored)
+      :
+      fd(aFd),
+      colored(aColored),
+      midLine(false)
+    {
+    }
+
+    const int fd;
+    const bool colored;
+    bool midLine; // the last write ended inside a line
+    std::string buffer; // not written yet
+  };
+
+  Formatter formatter;
+  const Options options;
+  Stream out;
+  Stream err;
+  std::atomic< std::uint64_t > droppedLines;
+  std::atomic< std::uint64_t > errors;
+
+  static bool useColors(int fd, ConsoleColors colors)
+  {
+    if (colors == ConsoleColors::AUTO)
+    {
+      return ::isatty(fd) == 1 && !std::getenv("NO_COLOR");
+    }
+    return colors == ConsoleColors::ALWAYS;
+  }
+
+  static const char* colorOf(Level level)
+  {
+    switch (level)
+    {
+    case Level::CRITICAL:
+      return "\x1b[1;31m";
+    case Level::ERROR:
+      return "\x1b[31m";
+    case Level::WARNING:
+      return "\x1b[33m";
+    case Level::INFO:
+      return "\x1b[32m";
+    case Level::DEBUG:
+      return "";
+    default:
+      return "\x1b[90m"; // TRACE and finer debug levels
+    }
+  }
+
+  /* the reset goes before the line end, so a colour never leaks into the next line */
+  static void appendColored(std::string& buffer, Level level, const std::string& text)
+  {
+    const char* color = colorOf(level);
+    if (!*color)
+    {
+      buffer += text;
+      return;
+    }
+    const auto lineEnd = !text.empty() && text.back() == '\n' ? text.size() - 1 : text.size();
+    buffer += color;
+    buffer.append(text, 0, lineEnd);
+    buffer += "\x1b[0m";
+    buffer.append(text, lineEnd, std::string::npos);
+  }
+
+  void write(Stream& stream)
+  {
+    const char* data = stream.buffer.data();
+    const std::size_t size = stream.buffer.size();
+    const auto deadline = std::chrono::steady_clock::now() + options.maxWait;
+
+    std::size_t written = 0;
+    while (written < size)
+    {
+      auto result = ::write(stream.fd, data + written, size - written);
+      if (result >= 0)
+      {
+        written += result;
+        continue;
+      }
+
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+        if (options.blockingPolicy == ConsoleBlockingPolicy::WAIT && waitWritable(stream.fd, deadline))
+        {
+          continue;
+        }
+        break; // the rest is retried on the next flush
+      }
+
+      // the reader is gone or the descriptor is unusable
+      errors.fetch_add(1, std::memory_order_relaxed);
+      stream.buffer.erase(0, written);
+      stream.midLine = false;
+      dropLines(stream, 0);
+      return;
+    }
+
+    if (written)
+    {
+      stream.midLine = data[written - 1] != '\n';
+    }
+    stream.buffer.erase(0, written);
+    if (stream.buffer.size() > options.maxPending)
+    {
+      // finish the line already partially written, drop the newer ones
+      std::size_t keep = 0;
+      if (stream.midLine)
+      {
+        const auto lineEnd = stream.buffer.find('\n');
+        keep = lineEnd == std::string::npos ? stream.buffer.size() : lineEnd + 1;
+      }
+      dropLines(stream, keep);
+    }
+  }
+
+  /* drops the buffer from `from` */
+  void dropLines(Stream& stream, std::size_t from)
+  {
+    const auto lines = std::count(stream.buffer.begin() + from, stream.buffer.end(), '\n');
+    droppedLines.fetch_add(lines, std::memory_order_relaxed);
+    stream.buffer.erase(from);
+  }
+
+  /* returns false if the descriptor did not become writable before the deadline */
+  static bool waitWritable(int fd, std::chrono::steady_clock::time_point deadline)
+  {
+    for (;;)
+    {
+      const auto left = std::chrono::duration_cast< std::chrono::milliseconds >(deadline - std::chrono::steady_clock::now());
+      if (left.count() <= 0)
+      {
+        return false;
+      }
+
+      pollfd descriptor = { fd, POLLOUT, 0 };
+      const auto result = ::poll(&descriptor, 1, static_cast< int >(left.count()));
+      if (result > 0)
+      {
+        return true;
+      }
+      if (result == 0 || errno != EINTR)
+      {
+        return false;
+      }
+    }
+  }
+};
+
+} // details
+} // logger
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "logger/Sink.hpp"
+
+#include "logger/details/EmergencyFlush.hpp"
+
+namespace logger
+{
+namespace details
+{
+
+/* Optional stage of the multithread sinks' drain loop:
+ * consecutive messages with the same (logger, call site, level, content) within `window`
+ * from the first one are not forwarded; the run ends with a single
+ * "last message repeated N times" message.
+ * A message is compared with the fields and a copy of the content of the run's first message,
+ * the cheap fields first, so a different message is usually told apart without touching its content.
+ */
+class DuplicateCollapser
+{
+public:
+  typedef DefaultClock::duration Duration;
+
+  DuplicateCollapser()
+    :
+    window(Duration::zero()),
+    runStarted(false),
+    runLogger(nullptr),
+    runFile(nullptr),
+    runLine(0),
+    runLevel(Level::NEVER),
+    repeats(0)
+  {
+  }
+
+  /* zero window disables collapsing */
+  void setWindow(Duration aWindow)
+  {
+    window = aWindow;
+  }
+
+  bool isEnabled() const
+  {
+    return window != Duration::zero();
+  }
+
+  void send(std::unique_ptr< Message > message, Sink& sink)
+  {
+    if (!isEnabled())
+    {
+      finishRun(sink); // a run left from before collapsing was disabled
+      sink.send(std::move(message));
+      return;
+    }
+
+    if (runStarted && message->time - runStart <= window && isRepeat(*message))
+    {
+      ++repeats;
+      lastRepeat = std::move(message);
+      return;
+    }
+
+    finishRun(sink);
+    runStart = message->time;
+    runStarted = true;
+    runLogger = message->loggerContext.get();
+    runFile = message->callContext.file;
+    runLine = message->callContext.line;
+    runLevel = message->level;
+    runContent = message->content; // reuses the capacity
+    sink.send(std::move(message));
+  }
+
+  /* crash path: the summary of the current run, async-signal-safe */
+  void emergencyWrite(int fd) const
+  {
+    if (!repeats)
+    {
+      return;
+    }
+    char digits[20];
+    std::size_t size = 0;
+    for (auto value = repeats; value; value /= 10)
+    {
+      digits[sizeof(digits) - ++size] = static_cast< char >('0' + value % 10);
+    }
+    static const char prefix[] = "last message repeated ";
+    static const char suffix[] = " times\n";
+    writeRaw(fd, prefix, sizeof(prefix) - 1);
+    writeRaw(fd, digits + sizeof(digits) - size, size);
+    writeRaw(fd, suffix, sizeof(suffix) - 1);
+  }
+
+  /* to be called at the end of each drain: reports a run whose window has passed */
+  void flush(Sink& sink)
+  {
+    if (repeats && DefaultClock::now() - runStart > window)
+    {
+      finishRun(sink);
+      runStarted = false;
+    }
+  }
+
+private:
+  Duration window;
+
+  bool runStarted;
+  std::chrono::time_point< DefaultClock > runStart;
+  const LoggerContext* runLogger; // the first message of the run, compared only
+  const char* runFile;
+  unsigned int runLine;
+  Level runLevel;
+  std::string runContent;
+  std::uint64_t repeats;
+  std::unique_ptr< Message > lastRepeat; // reused for the summary message
+
+  void finishRun(Sink& sink)
+  {
+    if (repeats)
+    {
+      lastRepeat->content = "last message repeated " + std::to_string(repeats) + " times";
+      sink.send(std::move(lastRepeat));
+      repeats = 0;
+    }
+  }
+
+  bool isRepeat(const Message& message) const
+  {
+    return message.callContext.line == runLine && message.callContext.file == runFile
+      && message.level == runLevel && message.loggerContext.get() == runLogger
+      && message.content == runContent; // the sizes first
+  }
+};
+
+} // details
+} // logger
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <atomic>
+#include <csignal>
+#include <fstream>
+#include <string>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "logger/Sink.hpp"
+
+namespace logger
+{
+namespace details
+{
+
+/* writes the whole text, async-signal-safe */
+inline void writeRaw(int fd, const char* data, std::size_t size)
+{
+#ifndef _WIN32
+  while (size)
+  {
+    auto result = ::write(fd, data, size);
+    if (result < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return;
+    }
+    data += result;
+    size -= result;
+  }
+#endif
+}
+
+/* the raw content of a message as a line, async-signal-safe */
+inline void writeRawMessage(int fd, const Message& message)
+{
+  writeRaw(fd, message.content.data(), message.content.size());
+  writeRaw(fd, "\n", 1);
+}
+
+/* a file buffer whose content not written to the file yet can be reached on the crash path */
+class EmergencyFileBuffer : public std::filebuf
+{
+public:
+  void emergencyWrite(int fd) const
+  {
+    if (pbase() && pptr() > pbase())
+    {
+      writeRaw(fd, pbase(), pptr() - pbase());
+    }
+  }
+};
+
+/* Last resort on a crash: on a fatal signal the messages still waiting in the multithread sinks
+ * (and in sink buffers) are written, raw, without formatting, to a file opened in advance
+ * (see Sink::emergencyWrite). Best effort - a queue locked by the crashed thread is skipped.
+ * The sinks register themselves; the handler only reads fixed slots, never allocates or waits.
+ * Process wide and never destroyed.
+ */
+class EmergencyFlush
+{
+public:
+  static const std::size_t MAX_SINKS = 64;
+
+  static EmergencyFlush& instance()
+  {
+    static EmergencyFlush* flush = new EmergencyFlush();
+    return *flush;
+  }
+
+  /* opens (appends to) the file and installs the handlers, chained to the previous ones */
+  bool install(const std::string& fileName)
+  {
+#ifndef _WIN32
+    const int opened = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (opened == -1)
+    {
+      return false;
+    }
+    const int previous = fd.exchange(opened);
+    if (previous != -1)
+    {
+      ::close(previous);
+    }
+
+    std::size_t count;
+    auto fatal = fatalSignals(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      auto handler = std::signal(fatal[i].number, onCrashSignal);
+      if (handler != onCrashSignal)
+      {
+        fatal[i].previous = handler;
+      }
+    }
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  /* a sink added twice is written once */
+  void add(Sink* sink)
+  {
+    for (auto& slot : sinks)
+    {
+      if (slot.load() == sink)
+      {
+        return;
+      }
+    }
+    for (auto& slot : sinks)
+    {
+      Sink* expected = nullptr;
+      if (slot.compare_exchange_strong(expected, sink))
+      {
+        return;
+      }
+    }
+    // more sinks than slots: this one is not flushed on a crash
+  }
+
+  void remove(Sink* sink)
+  {
+    for (auto& slot : sinks)
+    {
+      Sink* expected = sink;
+      if (slot.compare_exchange_strong(expected, nullptr))
+      {
+        return;
+      }
+    }
+  }
+
+  /* async-signal-safe (as far as the sinks' emergencyWrite are) */
+  void write()
+  {
+    const int target = fd.load();
+    if (target == -1)
+    {
+      return;
+    }
+
+    static const char header[] = "--- emergency flush of pending log messages ---\n";
+    writeRaw(target, header, sizeof(header) - 1);
+    for (auto& slot : sinks)
+    {
+      auto sink = slot.load();
+      if (sink)
+      {
+        sink->emergencyWrite(target);
+      }
+    }
+  }
+
+private:
+  typedef void (*SignalHandler)(int);
+
+  struct FatalSignal
+  {
+    int number;
+    SignalHandler previous;
+  };
+
+  std::atomic< Sink* > sinks[MAX_SINKS];
+  std::atomic< int > fd;
+
+  EmergencyFlush()
+    :
+    fd(-1)
+  {
+    for (auto& slot : sinks)
+    {
+      slot.store(nullptr);
+    }
+  }
+
+  static FatalSignal* fatalSignals(std::size_t& count)
+  {
+    static FatalSignal fatal[] = {
+      { SIGSEGV, nullptr },
+      { SIGFPE, nullptr },
+      { SIGILL, nullptr },
+      { SIGABRT, nullptr },
+#ifdef SIGBUS
+      { SIGBUS, nullptr },
+#endif
+    };
+    count = sizeof(fatal) / sizeof(fatal[0]);
+    return fatal;
+  }
+
+  static void onCrashSignal(int signal)
+  {
+    static std::atomic_flag handling = ATOMIC_FLAG_INIT;
+    if (!handling.test_and_set())
+    {
+      instance().write();
+    }
+
+    std::size_t count;
+    auto fatal = fatalSignals(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      auto previous = fatal[i].previous;
+      std::signal(fatal[i].number, previous && previous != SIG_ERR ? previous : SIG_DFL);
+    }
+    std::raise(signal);
+  }
+};
+
+} // details
+} // logger
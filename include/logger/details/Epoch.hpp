@@ -0,0 +1,222 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace logger
+{
+namespace details
+{
+
+/* Epoch based reclamation for read-mostly objects (e.g. Logger's configuration).
+ *
+ * Readers enter a critical section (EpochGuard) before loading a shared pointer: a store and
+ * a fence on the thread's own slot, no lock and no reference counting. Writers publish a new
+ * object and retire() the old one, it is deleted once every thread which could still see it
+ * has left its critical section. Retired objects are deleted by later retire() or reclaim() calls.
+ */
+class EpochDomain
+{
+public:
+  /* the process wide domain, intentionally never destroyed: exiting threads still use it */
+  static EpochDomain& instance()
+  {
+    static EpochDomain* domain = new EpochDomain();
+    return *domain;
+  }
+
+  void enter()
+  {
+    auto& participant = localParticipant();
+    if (participant.depth++ == 0)
+    {
+      participant.epoch.store(globalEpoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst); // the epoch is visible before the protected load
+    }
+  }
+
+  void exit()
+  {
+    auto& participant = localParticipant();
+    if (--participant.depth == 0)
+    {
+      participant.epoch.store(QUIESCENT, std::memory_order_release);
+    }
+  }
+
+  /* `object` has already been replaced by a new one */
+  template< typename T >
+  void retire(const T* object)
+  {
+    if (!object)
+    {
+      return;
+    }
+    {
+      std::lock_guard< std::mutex > lock(retiredMt);
+      retired.push_back(Retired{ globalEpoch.fetch_add(1), object, [](const void* pointer)
+      {
+        delete static_cast< const T* >(pointer);
+      } });
+      retiredCount.store(retired.size(), std::memory_order_relaxed);
+    }
+    reclaim();
+  }
+
+  /* deletes retired objects no reader can see anymore, cheap when there is nothing to do */
+  void reclaim()
+  {
+    if (retiredCount.load(std::memory_order_relaxed) == 0)
+    {
+      return;
+    }
+
+    std::vector< Retired > expired;
+    {
+      std::lock_guard< std::mutex > lock(retiredMt);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      const auto oldest = oldestActiveEpoch();
+      for (auto it = retired.begin(); it != retired.end();)
+      {
+        if (it->epoch < oldest)
+        {
+          expired.push_back(*it);
+          it = retired.erase(it);
+        }
+        else
+        {
+          ++it;
+        }
+      }
+      retiredCount.store(retired.size(), std::memory_order_relaxed);
+    }
+
+    // outside of the lock, destructors may retire other objects
+    for (auto& entry : expired)
+    {
+      entry.deleter(entry.object);
+    }
+  }
+
+private:
+  static const std::uint64_t QUIESCENT = 0;
+
+  /* one per thread, reused after the thread exits; padded so readers do not share cache lines */
+  struct Participant
+  {
+    char paddingBefore[64];
+    std::atomic< std::uint64_t > epoch;
+    std::atomic< bool > inUse;
+    unsigned depth; // nesting of critical sections, owning thread only
+    Participant* next;
+    char paddingAfter[64];
+  };
+
+  /* releases the thread's participant when the thread exits */
+  struct ThreadEntry
+  {
+    Participant* participant;
+
+    explicit ThreadEntry(EpochDomain& domain)
+      :
+      participant(domain.acquireParticipant())
+    {
+    }
+
+    ~ThreadEntry()
+    {
+      participant->epoch.store(QUIESCENT, std::memory_order_release);
+      participant->inUse.store(false, std::memory_order_release);
+    }
+  };
+
+  struct Retired
+  {
+    std::uint64_t epoch; // global epoch when the object was retired
+    const void* object;
+    void (*deleter)(const void*);
+  };
+
+  std::atomic< std::uint64_t > globalEpoch;
+  std::atomic< Participant* > participants; // list of all participants, never shrinks
+
+  std::mutex retiredMt; // guards retired
+  std::vector< Retired > retired;
+  std::atomic< std::size_t > retiredCount;
+
+  EpochDomain()
+    :
+    globalEpoch(QUIESCENT + 1),
+    participants(nullptr),
+    retiredCount(0)
+  {
+  }
+
+  Participant& localParticipant()
+  {
+    thread_local ThreadEntry entry(*this);
+    return *entry.participant;
+  }
+
+  Participant* acquireParticipant()
+  {
+    for (auto participant = participants.load(std::memory_order_acquire); participant; participant = participant->next)
+    {
+      bool expected = false;
+      if (!participant->inUse.load(std::memory_order_relaxed)
+        && participant->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire))
+      {
+        participant->depth = 0;
+        return participant;
+      }
+    }
+
+    auto participant = new Participant();
+    participant->epoch.store(QUIESCENT, std::memory_order_relaxed);
+    participant->inUse.store(true, std::memory_order_relaxed);
+    participant->depth = 0;
+    participant->next = participants.load(std::memory_order_relaxed);
+    while (!participants.compare_exchange_weak(participant->next, participant, std::memory_order_release, std::memory_order_relaxed))
+    {
+    }
+    return participant;
+  }
+
+  /* objects retired before the returned epoch are not visible to any reader */
+  std::uint64_t oldestActiveEpoch() const
+  {
+    auto oldest = globalEpoch.load(std::memory_order_acquire);
+    for (auto participant = participants.load(std::memory_order_acquire); participant; participant = participant->next)
+    {
+      const auto epoch = participant->epoch.load(std::memory_order_acquire);
+      if (epoch != QUIESCENT && epoch < oldest)
+      {
+        oldest = epoch;
+      }
+    }
+    return oldest;
+  }
+};
+
+/* RAII critical section of the EpochDomain */
+class EpochGuard
+{
+public:
+  EpochGuard()
+  {
+    EpochDomain::instance().enter();
+  }
+
+  ~EpochGuard()
+  {
+    EpochDomain::instance().exit();
+  }
+
+  EpochGuard(const EpochGuard&) = delete;
+  EpochGuard& operator=(const EpochGuard&) = delete;
+};
+
+} // details
+} // logger
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "logger/Message.hpp"
+
+namespace logger
+{
+namespace details
+{
+
+/* Sidecar index of a log file (<log file>.idx), a header followed by fixed size entries.
+ * Each entry describes one chunk of the log file: a compressed frame (FileLayout::FRAMES)
+ * or a range of plain text lines (FileLayout::PLAIN).
+ * Entries are appended when a chunk is complete, so the end of a file being written
+ * may not be indexed yet.
+ */
+enum class FileLayout : std::uint32_t
+{
+  PLAIN = 0,
+  FRAMES = 1
+};
+
+struct FileIndexHeader
+{
+  char magic[4];          // "LGIX"
+  std::uint32_t version;
+  FileLayout layout;
+  std::uint32_t reserved;
+};
+
+struct FileIndexEntry
+{
+  std::uint64_t offset;   // of the chunk in the log file
+  std::uint64_t size;     // of the chunk in the log file
+  std::int64_t minTime;   // DefaultClock ticks since epoch
+  std::int64_t maxTime;
+  std::uint32_t levels;   // bit (1 << Level) set for every level present in the chunk
+  std::uint32_t messages;
+  std::uint64_t loggers;  // bloom filter of logger names present in the chunk, see loggerBits()
+};
+
+const std::uint32_t FILE_INDEX_VERSION = 2;
+
+inline std::string indexFileName(const std::string& logFileName)
+{
+  return logFileName + ".idx";
+}
+
+inline std::uint32_t levelBit(Level level)
+{
+  return 1u << static_cast< unsigned >(level);
+}
+
+/* bits of `level` and all more severe levels */
+inline std::uint32_t levelsAtOrAbove(Level level)
+{
+  return ~(levelBit(level) - 1);
+}
+
+/* two bits of the 64 bit bloom filter, FNV-1a of the name */
+inline std::uint64_t loggerBits(const std::string& name)
+{
+  std::uint64_t hash = 14695981039346656037ull;
+  for (auto c : name)
+  {
+    hash = (hash ^ static_cast< unsigned char >(c)) * 1099511628211ull;
+  }
+  return (1ull << (hash & 63)) | (1ull << ((hash >> 6) & 63));
+}
+
+/* collects the statistics of the current chunk and appends its entry when it is complete */
+class FileIndexWriter
+{
+public:
+  FileIndexWriter(const std::string& logFileName, FileLayout layout)
+    :
+    file(indexFileName(logFileName), std::ofstream::out | std::ofstream::binary),
+    lastLoggerBits(0)
+  {
+    FileIndexHeader header;
+    std::memcpy(header.magic, "LGIX", sizeof(header.magic));
+    header.version = FILE_INDEX_VERSION;
+    header.layout = layout;
+    header.reserved = 0;
+    file.write(reinterpret_cast< const char* >(&header), sizeof(header));
+    reset();
+  }
+
+  /* `offset` - offset of the chunk the message belongs to, only the chunk's first one is used */
+  void add(const Message& message, std::uint64_t offset)
+  {
+    const std::int64_t time = message.time.time_since_epoch().count();
+    if (!entry.messages)
+    {
+      entry.offset = offset;
+      entry.minTime = time;
+      entry.maxTime = time;
+    }
+    entry.minTime = time < entry.minTime ? time : entry.minTime;
+    entry.maxTime = time > entry.maxTime ? time : entry.maxTime;
+    entry.levels |= levelBit(message.level);
+    entry.loggers |= getLoggerBits(message.loggerContext);
+    ++entry.messages;
+  }
+
+  bool isChunkEmpty() const
+  {
+    return entry.messages == 0;
+  }
+
+  /* appends the entry of the current chunk, which ends at `endOffset`, the next message starts a new one */
+  void closeChunk(std::uint64_t endOffset)
+  {
+    if (!isChunkEmpty())
+    {
+      entry.size = endOffset - entry.offset;
+      file.write(reinterpret_cast< const char* >(&entry), sizeof(entry));
+      reset();
+    }
+  }
+
+  void flush()
+  {
+    file.flush();
+  }
+
+private:
+  std::ofstream file;
+  FileIndexEntry entry;
+  std::shared_ptr< const LoggerContext > lastLogger; // kept alive, so its address is not reused
+  std::uint64_t lastLoggerBits;
+
+  std::uint64_t getLoggerBits(const std::shared_ptr< const LoggerContext >& logger)
+  {
+    if (logger != lastLogger)
+    {
+      lastLogger = logger;
+      lastLoggerBits = loggerBits(logger->name);
+    }
+    return lastLoggerBits;
+  }
+
+  void reset()
+  {
+    std::memset(&entry, 0, sizeof(entry));
+  }
+};
+
+/* returns false if the index is missing or malformed */
+inline bool readFileIndex(const std::string& logFileName, FileIndexHeader& header, std::vector< FileIndexEntry >& entries)
+{
+  std::ifstream file(indexFileName(logFileName), std::ifstream::in | std::ifstream::binary);
+  if (!file.read(reinterpret_cast< char* >(&header), sizeof(header))
+    || std::memcmp(header.magic, "LGIX", sizeof(header.magic)) != 0 || header.version != FILE_INDEX_VERSION)
+  {
+    return false;
+  }
+
+  entries.clear();
+  FileIndexEntry entry;
+  while (file.read(reinterpret_cast< char* >(&entry), sizeof(entry)))
+  {
+    entries.push_back(entry);
+  }
+  return true;
+}
+
+/* true if the chunk may contain messages from [from, to] at one of the levels
+ * and, when `loggers` is not zero, from the logger of these loggerBits()
+ */
+inline bool chunkMatches(const FileIndexEntry& entry, std::int64_t from, std::int64_t to, std::uint32_t levels, std::uint64_t loggers = 0)
+{
+  return entry.maxTime >= from && entry.minTime <= to && (entry.levels & levels) != 0
+    && (entry.loggers & loggers) == loggers;
+}
+
+} // details
+} // logger
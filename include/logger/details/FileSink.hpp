@@ -2,37 +2,205 @@
 
 #include <atomic>
 #include <fstream>
+#include <memory>
+#include <stdexcept>
 
 #include "logger/Sink.hpp"
 #include "logger/Formatter.hpp"
 
+#include "logger/details/EmergencyFlush.hpp"
+#include "logger/details/FileIndex.hpp"
+#include "logger/details/GroupCommit.hpp"
+#include "logger/details/IoErrors.hpp"
+
 namespace logger
 {
 namespace details
 {
 
+/* `indexInterval` - when not zero, a sparse index (see FileIndex.hpp) with an entry
+ * every `indexInterval` bytes is written to <name>.idx, see src/query
+ * indexed files are opened in binary mode, so the offsets match the file
+ * durable messages are synced to the disk in groups by flush(), without periodic flushes
+ * when written, see GroupCommit
+ * write errors are counted and reported to the handler, see IoErrors
+ * `append` - keeps the content of an existing file, not for indexed files (their offsets)
+ */
 class FileSink : public Sink
 {
 public:
-  explicit FileSink(const std::string& name, Formatter _formatter)
+  explicit FileSink(const std::string& name, Formatter _formatter, std::size_t aIndexInterval = 0, bool append = false)
     :
-    formatter(_formatter)
+    file(&buffer),
+    formatter(_formatter),
+    indexInterval(aIndexInterval),
+    offset(0),
+    chunkOffset(0),
+    errors(name)
+  {
+    if (indexInterval && append)
+    {
+      throw std::invalid_argument("FileSink: an indexed file cannot be appended to");
+    }
+    std::ios::openmode mode = std::ios::out;
+    if (indexInterval)
+    {
+      mode |= std::ios::binary;
+    }
+    else if (append)
+    {
+      mode |= std::ios::app;
+    }
+    if (!buffer.open(name, mode))
+    {
+      file.setstate(std::ios::failbit);
+    }
+    commits.open(name);
+    if (indexInterval)
+    {
+      index = std::make_unique< FileIndexWriter >(name, FileLayout::PLAIN);
+    }
+  }
+
+  virtual ~FileSink()
   {
-    file.open(name, std::ofstream::out/* | std::ofstream::app*/);
+    file.flush();
+    errors.checkFlush(file);
+    commits.commit(!errors.takeFailed());
+    if (index)
+    {
+      index->closeChunk(offset);
+    }
   }
 
   virtual void send(std::unique_ptr<Message> message) override
   {
-    file << formatter(*message);// << std::endl;
+    if (commits.opensGroup(*message))
+    {
+      errors.takeFailed(); // an error of earlier writes does not fail the group
+    }
+
+    if (!index)
+    {
+      file << formatter(*message);// << std::endl;
+      errors.checkWrite(file);
+      commits.add(*message);
+      commitOnWrite();
+      return;
+    }
+
+    auto text = formatter(*message);
+    if (index->isChunkEmpty())
+    {
+      chunkOffset = offset;
+    }
+    index->add(*message, chunkOffset);
+    file << text;
+    errors.checkWrite(file);
+    offset += text.size();
+    commits.add(*message);
+    commitOnWrite();
+
+    if (offset - chunkOffset >= indexInterval)
+    {
+      index->closeChunk(offset);
+    }
+  }
+
+  /* the text goes to a single index chunk */
+  virtual void sendFormatted(const std::string& text, std::vector< std::unique_ptr< Message > >& messages) override
+  {
+    for (const auto& message : messages)
+    {
+      if (commits.opensGroup(*message))
+      {
+        errors.takeFailed();
+      }
+      if (index)
+      {
+        if (index->isChunkEmpty())
+        {
+          chunkOffset = offset;
+        }
+        index->add(*message, chunkOffset);
+      }
+    }
+
+    file << text;
+    errors.checkWrite(file);
+    offset += text.size();
+    for (const auto& message : messages)
+    {
+      commits.add(*message);
+    }
+    commitOnWrite();
+
+    if (index && offset - chunkOffset >= indexInterval)
+    {
+      index->closeChunk(offset);
+    }
   }
 
   virtual void flush() override
   {
     file.flush();
+    errors.checkFlush(file);
+    commits.flushed();
+    if (commits.isDue())
+    {
+      commits.commit(!errors.takeFailed());
+    }
+    if (index)
+    {
+      index->flush();
+    }
+  }
+
+  /* minimal time between two syncs of durable messages */
+  void setCommitInterval(GroupCommit::Clock::duration interval)
+  {
+    commits.setInterval(interval);
   }
+
+  /* set it before the sink is used */
+  void setErrorHandler(IoErrors::Handler handler)
+  {
+    errors.setHandler(std::move(handler));
+  }
+
+  std::uint64_t getErrorCount() const
+  {
+    return errors.getCount();
+  }
+
+  /* the formatted text still in the stream buffer */
+  virtual void emergencyWrite(int fd) override
+  {
+    buffer.emergencyWrite(fd);
+  }
+
 private:
-  std::ofstream file;
+  EmergencyFileBuffer buffer;
+  std::ostream file;
   Formatter formatter;
+
+  const std::size_t indexInterval;
+  std::unique_ptr< FileIndexWriter > index; // nullptr - no index
+  std::uint64_t offset;      // bytes written
+  std::uint64_t chunkOffset; // where the chunk of the next index entry begins
+
+  GroupCommit commits;
+  IoErrors errors;
+
+  void commitOnWrite()
+  {
+    if (commits.isDueOnWrite())
+    {
+      file.flush();
+      errors.checkFlush(file);
+      commits.commit(!errors.takeFailed());
+    }
+  }
 };
 
 } // details
@@ -0,0 +1,467 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "logger/Sink.hpp"
+#include "logger/StringHelpers.hpp"
+
+#include "logger/details/EmergencyFlush.hpp"
+#include "logger/details/MemoryPolicy.hpp"
+
+namespace logger
+{
+namespace details
+{
+
+/* Keeps the recent history of every thread in memory and writes it out only when triggered.
+ *
+ * Each thread writes into its own fixed size ring of fixed size slots, overwriting the oldest
+ * slot: no lock, no allocation and no formatting on the logging side. Slots are guarded by
+ * a sequence lock, so a dump can read them while the owning thread keeps writing.
+ * Content longer than a slot is truncated. A ring is allocated by its thread, with the default
+ * MemoryPolicy on that thread's NUMA node. The ring of an exited thread, history included, is
+ * taken over by the next new thread (possibly on another node): the memory is bounded by the
+ * peak number of logging threads, not by the number of threads ever started.
+ *
+ * The history is dumped (merged by time, every record once) through `dumpSink`, usually
+ * a FileSink, when:
+ *  - a message at or above `triggerLevel` is sent,
+ *  - dump() is called,
+ *  - a fatal signal arrives, see installCrashHandler() - raw, through EmergencyFlush.
+ *
+ * Has to be used directly as a Logger's sink, not behind a multithread sink, the rings are
+ * per producer thread.
+ */
+class FlightRecorderSink : public Sink
+{
+public:
+  static const std::size_t SLOT_SIZE = 256;
+  static const std::size_t DEFAULT_SLOTS_PER_THREAD = 4096;
+
+  explicit FlightRecorderSink(std::shared_ptr< Sink > aDumpSink, Level aTriggerLevel = Level::ERROR,
+    std::size_t slotsPerThread = DEFAULT_SLOTS_PER_THREAD, const MemoryPolicy& aMemoryPolicy = MemoryPolicy())
+    :
+    dumpSink(aDumpSink),
+    triggerLevel(aTriggerLevel),
+    slotCount(roundUpToPowerOfTwo(slotsPerThread)),
+    memoryPolicy(aMemoryPolicy),
+    id(nextId()++)
+  {
+  }
+
+  virtual ~FlightRecorderSink()
+  {
+    EmergencyFlush::instance().remove(this);
+  }
+
+  virtual void send(std::unique_ptr<Message> message) override
+  {
+    getRing().record(*message);
+
+    if (message->level >= triggerLevel)
+    {
+      dump();
+    }
+  }
+
+  virtual void flush() override
+  {
+    // nothing is written until a dump
+  }
+
+  /* writes records not dumped before, returns their number */
+  std::size_t dump()
+  {
+    std::lock_guard< std::mutex > lock(dumpMt);
+
+    std::vector< Record > records;
+    {
+      std::lock_guard< std::mutex > ringsLock(ringsMt);
+      for (auto& ring : rings)
+      {
+        ring->collect(records);
+      }
+    }
+
+    std::stable_sort(records.begin(), records.end(),
+      [](const Record& left, const Record& right)
+    {
+      return left.slot.time < right.slot.time;
+    }
+    );
+
+    for (const auto& record : records)
+    {
+      dumpSink->send(rebuild(record));
+    }
+    dumpSink->flush();
+    return records.size();
+  }
+
+  /* On a fatal signal the records not dumped yet are written to `fileName` (opened now) by
+   * EmergencyFlush, chained to the previous handlers. May be called for several recorders and
+   * more than once; the file is shared with the other sinks registered there.
+   */
+  bool installCrashHandler(const std::string& fileName)
+  {
+    EmergencyFlush::instance().add(this);
+    return EmergencyFlush::instance().install(fileName);
+  }
+
+  /* Crash path: the records not dumped yet, merged by time, as raw "LEVEL content" lines.
+   * Async-signal-safe: nothing is allocated or formatted, skipped if a thread is registering
+   * its ring just now.
+   */
+  virtual void emergencyWrite(int fd) override
+  {
+    if (!ringsMt.try_lock())
+    {
+      return;
+    }
+
+    for (auto& ring : rings)
+    {
+      ring->rewind();
+    }
+    SlotCopy oldest;
+    SlotCopy candidate;
+    for (;;)
+    {
+      Ring* oldestRing = nullptr;
+      for (auto& ring : rings)
+      {
+        if (ring->peek(candidate) && (!oldestRing || candidate.time < oldest.time))
+        {
+          oldest = candidate;
+          oldestRing = ring.get();
+        }
+      }
+      if (!oldestRing)
+      {
+        break;
+      }
+      oldestRing->advance();
+
+      const char* level = toString(static_cast< Level >(oldest.level));
+      writeRaw(fd, level, std::strlen(level));
+      writeRaw(fd, " ", 1);
+      writeRaw(fd, oldest.content, oldest.contentSize);
+      writeRaw(fd, "\n", 1);
+    }
+    ringsMt.unlock();
+  }
+
+private:
+  /* followed by the content bytes, up to SLOT_SIZE */
+  struct Slot
+  {
+    std::atomic< std::uint32_t > sequence; // odd while the slot is being written
+    std::uint32_t level;
+    std::uint32_t line;
+    std::uint32_t contentSize;
+    std::int64_t time;
+    const char* file;
+    const char* function;
+    const LoggerContext* logger;
+    std::thread::id threadId; // rings change owners
+
+    char* content()
+    {
+      return reinterpret_cast< char* >(this + 1);
+    }
+
+    const char* content() const
+    {
+      return reinterpret_cast< const char* >(this + 1);
+    }
+  };
+
+  static const std::size_t CONTENT_CAPACITY = SLOT_SIZE - sizeof(Slot);
+
+  /* plain copy of a slot taken by a dump */
+  struct SlotCopy
+  {
+    std::uint32_t level;
+    std::uint32_t line;
+    std::uint32_t contentSize;
+    std::int64_t time;
+    const char* file;
+    const char* function;
+    const LoggerContext* logger;
+    std::thread::id threadId;
+    char content[CONTENT_CAPACITY];
+  };
+
+  struct Record
+  {
+    SlotCopy slot;
+  };
+
+  /* ring of a single thread at a time, written only by this thread */
+  class Ring
+  {
+  public:
+    Ring(std::size_t aSlotCount, const MemoryPolicy& memoryPolicy)
+      :
+      slotCount(aSlotCount),
+      memory(aSlotCount * SLOT_SIZE, memoryPolicy),
+      owned(true),
+      head(0),
+      dumped(0),
+      crashCursor(0),
+      crashEnd(0)
+    {
+      for (std::size_t i = 0; i < slotCount; ++i)
+      {
+        new (&slot(i).sequence) std::atomic< std::uint32_t >(0);
+      }
+    }
+
+    void record(const Message& message)
+    {
+      const auto index = head.load(std::memory_order_relaxed);
+      auto& target = slot(index & (slotCount - 1));
+
+      const auto sequence = target.sequence.load(std::memory_order_relaxed);
+      target.sequence.store(sequence + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+
+      target.level = static_cast< std::uint32_t >(message.level);
+      target.line = message.callContext.line;
+      target.time = message.time.time_since_epoch().count();
+      target.file = message.callContext.file;
+      target.function = message.callContext.function;
+      target.logger = retain(message.loggerContext);
+      target.threadId = message.threadId;
+      const auto contentSize = message.content.size() < CONTENT_CAPACITY ? message.content.size() : CONTENT_CAPACITY;
+      target.contentSize = static_cast< std::uint32_t >(contentSize);
+      std::memcpy(target.content(), message.content.data(), contentSize);
+
+      target.sequence.store(sequence + 2, std::memory_order_release);
+      head.store(index + 1, std::memory_order_release);
+    }
+
+    /* appends records written since the previous collect, dumpMt has to be locked */
+    void collect(std::vector< Record >& records)
+    {
+      const auto end = head.load(std::memory_order_acquire);
+      const auto begin = std::max< std::uint64_t >(dumped, end > slotCount ? end - slotCount : 0);
+      for (auto index = begin; index < end; ++index)
+      {
+        Record record;
+        if (read(slot(index & (slotCount - 1)), record.slot))
+        {
+          records.push_back(record);
+        }
+      }
+      dumped = end;
+    }
+
+    /* takes the ring of an exited thread */
+    bool acquire()
+    {
+      bool expected = false;
+      return owned.compare_exchange_strong(expected, true, std::memory_order_acquire);
+    }
+
+    /* the owning thread exits */
+    void release()
+    {
+      owned.store(false, std::memory_order_release);
+    }
+
+    /* crash path cursor over the records not dumped, see emergencyWrite() */
+    void rewind()
+    {
+      crashEnd = head.load(std::memory_order_acquire);
+      crashCursor = std::max< std::uint64_t >(dumped, crashEnd > slotCount ? crashEnd - slotCount : 0);
+    }
+
+    /* the record at the cursor, overwritten ones are skipped; false at the end */
+    bool peek(SlotCopy& copy)
+    {
+      for (; crashCursor < crashEnd; ++crashCursor)
+      {
+        if (read(slot(crashCursor & (slotCount - 1)), copy))
+        {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    void advance()
+    {
+      ++crashCursor;
+    }
+
+  private:
+    const std::uint64_t slotCount;
+    MemoryBlock memory;
+    std::atomic< bool > owned; // by a running thread
+    std::atomic< std::uint64_t > head; // number of records ever written
+    std::uint64_t dumped;              // records up to this number were dumped already
+    std::uint64_t crashCursor;         // used by the crash path only
+    std::uint64_t crashEnd;
+
+    // keep loggers referenced by slots alive, written only by the owning thread
+    std::vector< std::shared_ptr< const LoggerContext > > loggers;
+
+    Slot& slot(std::uint64_t index)
+    {
+      return *reinterpret_cast< Slot* >(memory.get() + index * SLOT_SIZE);
+    }
+
+    const LoggerContext* retain(const std::shared_ptr< const LoggerContext >& logger)
+    {
+      if (loggers.empty() || loggers.back() != logger)
+      {
+        auto found = std::find(loggers.begin(), loggers.end(), logger);
+        if (found == loggers.end())
+        {
+          loggers.push_back(logger);
+        }
+        else
+        {
+          std::iter_swap(found, loggers.end() - 1); // most recent at the back
+        }
+      }
+      return logger.get();
+    }
+
+    /* returns false if the slot was overwritten meanwhile */
+    static bool read(const Slot& source, SlotCopy& copy)
+    {
+      const auto before = source.sequence.load(std::memory_order_acquire);
+      if (before & 1)
+      {
+        return false;
+      }
+
+      copy.level = source.level;
+      copy.line = source.line;
+      copy.contentSize = source.contentSize;
+      copy.time = source.time;
+      copy.file = source.file;
+      copy.function = source.function;
+      copy.logger = source.logger;
+      copy.threadId = source.threadId;
+      if (copy.contentSize > CONTENT_CAPACITY)
+      {
+        return false;
+      }
+      std::memcpy(copy.content, source.content(), copy.contentSize);
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+      return source.sequence.load(std::memory_order_relaxed) == before && before != 0;
+    }
+  };
+
+  typedef std::shared_ptr< Ring > RingPtr;
+
+  /* gives the ring back when its thread exits */
+  struct RingLease
+  {
+    RingPtr ring;
+
+    RingLease() = default;
+    RingLease(const RingLease&) = delete;
+    RingLease& operator=(const RingLease&) = delete;
+
+    ~RingLease()
+    {
+      if (ring)
+      {
+        ring->release();
+      }
+    }
+  };
+
+  std::shared_ptr< Sink > dumpSink;
+  const Level triggerLevel;
+  const std::size_t slotCount;
+  const MemoryPolicy memoryPolicy;
+  const std::uint64_t id; // unique for the process lifetime, unlike `this`
+
+  std::mutex dumpMt;  // one dump at the time
+  std::mutex ringsMt; // guards rings
+  std::vector< RingPtr > rings; // rings of exited threads are kept for new ones, their history is still useful
+
+  static std::atomic< std::uint64_t >& nextId()
+  {
+    static std::atomic< std::uint64_t > counter(1);
+    return counter;
+  }
+
+  static std::size_t roundUpToPowerOfTwo(std::size_t value)
+  {
+    std::size_t result = 1;
+    while (result < value)
+    {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  /* the thread's ring, taken over from an exited thread or created on first use */
+  Ring& getRing()
+  {
+    thread_local std::uint64_t lastId = 0;
+    thread_local Ring* lastRing = nullptr;
+    if (lastId == id)
+    {
+      return *lastRing;
+    }
+
+    thread_local std::unordered_map< std::uint64_t, RingLease > threadRings;
+    auto& lease = threadRings[id];
+    if (!lease.ring)
+    {
+      lease.ring = acquireRing();
+    }
+
+    lastId = id;
+    lastRing = lease.ring.get();
+    return *lease.ring;
+  }
+
+  RingPtr acquireRing()
+  {
+    std::lock_guard< std::mutex > lock(ringsMt);
+    for (auto& ring : rings)
+    {
+      if (ring->acquire())
+      {
+        return ring;
+      }
+    }
+    rings.push_back(std::make_shared< Ring >(slotCount, memoryPolicy));
+    return rings.back();
+  }
+
+  std::unique_ptr< Message > rebuild(const Record& record) const
+  {
+    // loggers are kept alive by the rings, a non-owning pointer is enough
+    std::shared_ptr< const LoggerContext > logger(std::shared_ptr< const LoggerContext >(), record.slot.logger);
+    CallContext callContext(record.slot.function, record.slot.function, record.slot.file, record.slot.line);
+
+    auto message = std::make_unique< Message >(callContext, logger);
+    message->level = static_cast< Level >(record.slot.level);
+    message->content.assign(record.slot.content, record.slot.contentSize);
+    message->time = std::chrono::time_point< DefaultClock >(DefaultClock::duration(record.slot.time));
+    message->threadId = record.slot.threadId;
+    return message;
+  }
+};
+
+} // details
+} // logger
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "logger/CommitHandle.hpp"
+#include "logger/Message.hpp"
+
+namespace logger
+{
+namespace details
+{
+
+/* Durability for a file sink, like a database log's group commit:
+ * durable messages are only collected when written, commit() makes all of them durable with
+ * a single fdatasync and releases their waiters together. The sink commits from flush() when
+ * isDue(), at most once per `interval`; requests arriving during a sync wait for the next one.
+ * Nothing else would commit without periodic flushes (no flushing thread, e.g. the plain
+ * Registry), so the sink also commits when writing if isDueOnWrite(): the interval passed,
+ * or flush() is not called periodically - the last two calls were not within an interval,
+ * a single flush() by hand does not hold the next durable message back.
+ */
+class GroupCommit
+{
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  explicit GroupCommit(Clock::duration aInterval = std::chrono::milliseconds(2))
+    :
+    interval(aInterval),
+    fd(-1)
+  {
+  }
+
+  ~GroupCommit()
+  {
+#ifndef _WIN32
+    if (fd != -1)
+    {
+      ::close(fd);
+    }
+#endif
+  }
+
+  GroupCommit(const GroupCommit&) = delete;
+  GroupCommit& operator=(const GroupCommit&) = delete;
+
+  /* opens the descriptor used for syncing (any descriptor of the file syncs its data), call it
+   * right after the sink opened the file, so a rename or rotation later does not change the file
+   * synced; without it (or if it fails) commits fail
+   */
+  void open(const std::string& fileName)
+  {
+#ifndef _WIN32
+    if (fd != -1)
+    {
+      ::close(fd);
+    }
+    fd = ::open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+  }
+
+  void setInterval(Clock::duration aInterval)
+  {
+    interval = aInterval;
+  }
+
+  /* whether the message opens a group, call before it is written */
+  bool opensGroup(const Message& message) const
+  {
+    return message.commit && pending.empty();
+  }
+
+  /* takes the ticket of a durable message, call after the message was written */
+  void add(Message& message)
+  {
+    if (message.commit)
+    {
+      pending.push_back(message.commit.release());
+    }
+  }
+
+  bool isDue() const
+  {
+    return !pending.empty() && Clock::now() - lastCommit >= interval;
+  }
+
+  bool isDueOnWrite() const
+  {
+    if (pending.empty())
+    {
+      return false;
+    }
+    const auto now = Clock::now();
+    const bool periodicFlush = now - lastFlush < interval && lastFlush - previousFlush < interval;
+    return now - lastCommit >= interval || !periodicFlush;
+  }
+
+  /* call from the sink's flush() */
+  void flushed()
+  {
+    previousFlush = lastFlush;
+    lastFlush = Clock::now();
+  }
+
+  /* the sink's buffers have to be flushed to the OS before, `written` - the writes succeeded */
+  void commit(bool written)
+  {
+    if (pending.empty())
+    {
+      return;
+    }
+
+    auto result = written && sync() ? CommitHandle::State::DURABLE : CommitHandle::State::FAILED;
+#ifdef _WIN32
+    result = CommitHandle::State::NOT_SUPPORTED;
+#endif
+    lastCommit = Clock::now();
+    for (auto& handle : pending)
+    {
+      handle->complete(result);
+    }
+    pending.clear();
+  }
+
+private:
+  Clock::duration interval;
+  int fd; // see open()
+  Clock::time_point lastCommit;
+  Clock::time_point lastFlush;
+  Clock::time_point previousFlush;
+  std::vector< std::shared_ptr< CommitHandle > > pending;
+
+  bool sync()
+  {
+#ifndef _WIN32
+    if (fd == -1)
+    {
+      return false;
+    }
+#ifdef __linux__
+    return ::fdatasync(fd) == 0;
+#else
+    return ::fsync(fd) == 0;
+#endif
+#else
+    return false;
+#endif
+  }
+};
+
+} // details
+} // logger
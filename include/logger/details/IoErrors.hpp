@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+
+namespace logger
+{
+namespace details
+{
+
+/* Write errors of a file sink (disk full, I/O error, file not opened) are counted and reported
+ * to the handler instead of being dropped silently. The handler is called on the thread writing,
+ * once per streak of failures: for the first one after a flush which reached the OS - a write
+ * into the stream's buffer succeeds even when the disk is full, so it does not end a streak.
+ * A failed stream is cleared, so the next writes are tried again (the disk may get free space).
+ */
+class IoErrors
+{
+public:
+  /* `error` - errno of the failed write, 0 if not known */
+  typedef std::function< void(const std::string& fileName, int error, std::uint64_t errorCount) > Handler;
+
+  explicit IoErrors(const std::string& aFileName)
+    :
+    fileName(aFileName),
+    count(0),
+    failing(false),
+    failedSinceTake(false)
+  {
+  }
+
+  /* set it before the sink is used */
+  void setHandler(Handler aHandler)
+  {
+    handler = std::move(aHandler);
+  }
+
+  std::uint64_t getCount() const
+  {
+    return count.load(std::memory_order_relaxed);
+  }
+
+  /* after writing to the stream, returns true if it is fine */
+  bool checkWrite(std::ostream& stream)
+  {
+    if (stream)
+    {
+      return true;
+    }
+    stream.clear();
+    return fail(errno);
+  }
+
+  /* after flushing the stream, returns true if it is fine */
+  bool checkFlush(std::ostream& stream)
+  {
+    if (stream)
+    {
+      failing = false;
+      return true;
+    }
+    stream.clear();
+    return fail(errno);
+  }
+
+  /* after a write without a stream buffer (it reached the OS), `error` - its errno, 0 if it succeeded */
+  bool checkCompleted(int error)
+  {
+    if (!error)
+    {
+      failing = false;
+      return true;
+    }
+    return fail(error);
+  }
+
+  /* whether a check failed since the previous call, e.g. to fail a group commit
+   * (called when the group opens too, so an older error does not fail it)
+   */
+  bool takeFailed()
+  {
+    const bool failed = failedSinceTake;
+    failedSinceTake = false;
+    return failed;
+  }
+
+private:
+  const std::string fileName;
+  Handler handler;
+  std::atomic< std::uint64_t > count;
+  bool failing;
+  bool failedSinceTake;
+
+  bool fail(int error)
+  {
+    failedSinceTake = true;
+    const auto errors = count.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (!failing)
+    {
+      failing = true;
+      if (handler)
+      {
+        handler(fileName, error, errors);
+      }
+    }
+    return false;
+  }
+};
+
+} // details
+} // logger
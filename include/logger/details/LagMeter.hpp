@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "logger/Message.hpp"
+
+namespace logger
+{
+namespace details
+{
+
+/* Consumer lag of a queueing sink (Backlog::lag): the age of the oldest message of the delivery
+ * in progress, or of the last delivery when it finished - a stuck write keeps the lag growing.
+ * Written by the thread inside the sink's flush(), read by any thread.
+ */
+class LagMeter
+{
+public:
+  LagMeter()
+    :
+    oldest(0),
+    finished(1)
+  {
+  }
+
+  /* a delivery begins, `oldestMessage` - time of its oldest message */
+  void begin(DefaultClock::time_point oldestMessage)
+  {
+    oldest.store(oldestMessage.time_since_epoch().count());
+    finished.store(0);
+  }
+
+  void end()
+  {
+    finished.store(DefaultClock::now().time_since_epoch().count());
+  }
+
+  /* nothing to deliver */
+  void idle()
+  {
+    const auto now = DefaultClock::now().time_since_epoch().count();
+    oldest.store(now);
+    finished.store(now);
+  }
+
+  DefaultClock::duration get() const
+  {
+    auto until = finished.load();
+    const auto since = oldest.load();
+    if (!until)
+    {
+      until = DefaultClock::now().time_since_epoch().count();
+    }
+    return DefaultClock::duration(until > since ? until - since : 0);
+  }
+
+private:
+  std::atomic< DefaultClock::rep > oldest;   // ticks since the clock's epoch
+  std::atomic< DefaultClock::rep > finished; // 0 - delivery in progress
+};
+
+} // details
+} // logger
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace logger
+{
+namespace details
+{
+
+/* Minimal LZ4 block format codec (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md)
+ * greedy single probe matching, the output can be decompressed by the reference library
+ * and vice versa. No dependency, fast enough for text logs compressed in the consumer thread.
+ */
+namespace lz4
+{
+
+const std::size_t MIN_MATCH = 4;
+const std::size_t LAST_LITERALS = 5;  // the last 5 bytes are always literals
+const std::size_t MATCH_FIND_LIMIT = 12; // the last match starts at least 12 bytes before the end
+const std::size_t MAX_OFFSET = 65535;
+const unsigned HASH_LOG = 14;
+
+inline std::size_t compressBound(std::size_t size)
+{
+  return size + size / 255 + 16;
+}
+
+inline std::uint32_t read32(const unsigned char* data)
+{
+  std::uint32_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+inline std::uint32_t hash(std::uint32_t sequence)
+{
+  return (sequence * 2654435761u) >> (32 - HASH_LOG);
+}
+
+inline unsigned char* writeLength(unsigned char* out, std::size_t length)
+{
+  for (; length >= 255; length -= 255)
+  {
+    *out++ = 255;
+  }
+  *out++ = static_cast< unsigned char >(length);
+  return out;
+}
+
+inline unsigned char* writeSequence(unsigned char* out, const unsigned char* literals, std::size_t literalSize,
+  std::size_t offset, std::size_t matchSize)
+{
+  unsigned char* token = out++;
+  *token = static_cast< unsigned char >((literalSize < 15 ? literalSize : 15) << 4);
+  if (literalSize >= 15)
+  {
+    out = writeLength(out, literalSize - 15);
+  }
+  std::memcpy(out, literals, literalSize);
+  out += literalSize;
+
+  if (matchSize == 0)
+  {
+    return out; // the last sequence has no match
+  }
+
+  *out++ = static_cast< unsigned char >(offset & 0xff);
+  *out++ = static_cast< unsigned char >(offset >> 8);
+  const auto matchCode = matchSize - MIN_MATCH;
+  *token |= static_cast< unsigned char >(matchCode < 15 ? matchCode : 15);
+  if (matchCode >= 15)
+  {
+    out = writeLength(out, matchCode - 15);
+  }
+  return out;
+}
+
+/* `destination` has to have compressBound(size) bytes, returns the compressed size */
+inline std::size_t compress(const char* source, std::size_t size, char* destination)
+{
+  const auto* in = reinterpret_cast< const unsigned char* >(source);
+  auto* out = reinterpret_cast< unsigned char* >(destination);
+
+  std::size_t anchor = 0;
+  if (size > MATCH_FIND_LIMIT)
+  {
+    std::vector< std::uint32_t > table(std::size_t(1) << HASH_LOG, 0); // position + 1, 0 - empty
+    const std::size_t matchLimit = size - LAST_LITERALS;
+    const std::size_t findLimit = size - MATCH_FIND_LIMIT;
+
+    std::size_t position = 0;
+    while (position < findLimit)
+    {
+      const auto sequence = read32(in + position);
+      auto& slot = table[hash(sequence)];
+      const std::size_t candidate = slot;
+      slot = static_cast< std::uint32_t >(position + 1);
+
+      if (candidate == 0 || position + 1 - candidate > MAX_OFFSET || read32(in + candidate - 1) != sequence)
+      {
+        ++position;
+        continue;
+      }
+
+      std::size_t reference = candidate - 1;
+      while (position > anchor && reference > 0 && in[position - 1] == in[reference - 1])
+      {
+        --position;
+        --reference;
+      }
+
+      std::size_t matchSize = MIN_MATCH;
+      while (position + matchSize < matchLimit && in[reference + matchSize] == in[position + matchSize])
+      {
+        ++matchSize;
+      }
+
+      out = writeSequence(out, in + anchor, position - anchor, position - reference, matchSize);
+      position += matchSize;
+      anchor = position;
+    }
+  }
+
+  out = writeSequence(out, in + anchor, size - anchor, 0, 0);
+  return out - reinterpret_cast< unsigned char* >(destination);
+}
+
+/* returns the decompressed size or -1 if the input is malformed or does not fit */
+inline std::int64_t decompress(const char* source, std::size_t size, char* destination, std::size_t capacity)
+{
+  const auto* in = reinterpret_cast< const unsigned char* >(source);
+  const auto* inEnd = in + size;
+  auto* out = reinterpret_cast< unsigned char* >(destination);
+  auto* outBegin = out;
+  auto* outEnd = out + capacity;
+
+  auto readLength = [&](std::size_t length) -> std::size_t
+  {
+    if (length != 15)
+    {
+      return length;
+    }
+    unsigned char more;
+    do
+    {
+      if (in == inEnd)
+      {
+        return SIZE_MAX;
+      }
+      more = *in++;
+      length += more;
+    } while (more == 255);
+    return length;
+  };
+
+  while (in < inEnd)
+  {
+    const unsigned token = *in++;
+
+    const auto literalSize = readLength(token >> 4);
+    if (literalSize > static_cast< std::size_t >(inEnd - in) || literalSize > static_cast< std::size_t >(outEnd - out))
+    {
+      return -1;
+    }
+    std::memcpy(out, in, literalSize);
+    in += literalSize;
+    out += literalSize;
+
+    if (in == inEnd)
+    {
+      break; // the last sequence
+    }
+
+    if (inEnd - in < 2)
+    {
+      return -1;
+    }
+    const std::size_t offset = in[0] | (in[1] << 8);
+    in += 2;
+    const auto matchSize = readLength(token & 15);
+    if (matchSize == SIZE_MAX || offset == 0 || offset > static_cast< std::size_t >(out - outBegin)
+      || matchSize + MIN_MATCH > static_cast< std::size_t >(outEnd - out))
+    {
+      return -1;
+    }
+
+    const unsigned char* match = out - offset;
+    for (std::size_t i = 0; i < matchSize + MIN_MATCH; ++i)
+    {
+      *out++ = *match++; // byte by byte, the match may overlap the output
+    }
+  }
+
+  return out - outBegin;
+}
+
+} // lz4
+} // details
+} // logger
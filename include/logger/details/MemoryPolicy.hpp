@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace logger
+{
+namespace details
+{
+
+/* Placement of the logging pipeline's large buffers (rings, write buffers).
+ * Uses plain mmap/mbind/madvise system calls on Linux, no libnuma; anything unsupported
+ * (no NUMA, no transparent huge pages, other platforms) silently falls back to ordinary memory.
+ */
+struct MemoryPolicy
+{
+  static const int ANY_NODE = -1;
+  static const int CURRENT_NODE = -2; // NUMA node of the allocating thread
+
+  int node = CURRENT_NODE;
+  bool hugePages = false; // 2MB transparent huge pages, sizes are rounded up to 2MB
+};
+
+/* NUMA node the calling thread runs on, -1 if unknown */
+inline int currentNumaNode()
+{
+#if defined(__linux__) && defined(SYS_getcpu)
+  unsigned cpu = 0;
+  unsigned node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+  {
+    return static_cast< int >(node);
+  }
+#endif
+  return -1;
+}
+
+/* zero initialized memory placed according to a MemoryPolicy */
+class MemoryBlock
+{
+public:
+  MemoryBlock()
+    :
+    data(nullptr),
+    size(0),
+    mapped(false)
+  {
+  }
+
+  MemoryBlock(std::size_t aSize, const MemoryPolicy& policy)
+    :
+    data(nullptr),
+    size(aSize),
+    mapped(false)
+  {
+#ifdef __linux__
+    data = map(size, policy);
+    mapped = data != nullptr;
+#endif
+    if (!data)
+    {
+      data = new char[size]();
+    }
+  }
+
+  MemoryBlock(MemoryBlock&& other)
+    :
+    data(other.data),
+    size(other.size),
+    mapped(other.mapped)
+  {
+    other.data = nullptr;
+  }
+
+  MemoryBlock& operator=(MemoryBlock&& other)
+  {
+    if (this != &other)
+    {
+      release();
+      data = other.data;
+      size = other.size;
+      mapped = other.mapped;
+      other.data = nullptr;
+    }
+    return *this;
+  }
+
+  MemoryBlock(const MemoryBlock&) = delete;
+  MemoryBlock& operator=(const MemoryBlock&) = delete;
+
+  ~MemoryBlock()
+  {
+    release();
+  }
+
+  char* get() const
+  {
+    return data;
+  }
+
+private:
+  static const std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+  char* data;
+  std::size_t size;
+  bool mapped; // mmap-ed (`size` is the mapped size), otherwise new[]-ed
+
+  void release()
+  {
+    if (!data)
+    {
+      return;
+    }
+#ifdef __linux__
+    if (mapped)
+    {
+      munmap(data, size);
+      data = nullptr;
+      return;
+    }
+#endif
+    delete[] data;
+    data = nullptr;
+  }
+
+#ifdef __linux__
+  static std::size_t mappedSize(std::size_t size, bool hugePages)
+  {
+    const std::size_t unit = hugePages ? HUGE_PAGE_SIZE : static_cast< std::size_t >(sysconf(_SC_PAGESIZE));
+    return (size + unit - 1) / unit * unit;
+  }
+
+  /* `length` is rounded up to the mapped size */
+  static char* map(std::size_t& length, const MemoryPolicy& policy)
+  {
+    const bool hugePages = policy.hugePages;
+    length = mappedSize(length, hugePages);
+
+    // huge pages need 2MB aligned addresses: map more and trim both ends
+    const std::size_t reserved = hugePages ? length + HUGE_PAGE_SIZE : length;
+    void* address = mmap(nullptr, reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (address == MAP_FAILED)
+    {
+      return nullptr;
+    }
+
+    char* begin = static_cast< char* >(address);
+    if (hugePages)
+    {
+      char* aligned = reinterpret_cast< char* >((reinterpret_cast< std::uintptr_t >(begin) + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+      if (aligned != begin)
+      {
+        munmap(begin, aligned - begin);
+      }
+      if (begin + reserved != aligned + length)
+      {
+        munmap(aligned + length, begin + reserved - (aligned + length));
+      }
+      begin = aligned;
+#ifdef MADV_HUGEPAGE
+      madvise(begin, length, MADV_HUGEPAGE);
+#endif
+    }
+
+    // pages are not touched yet, so the policy decides where they are allocated
+    const int node = policy.node == MemoryPolicy::CURRENT_NODE ? currentNumaNode() : policy.node;
+#ifdef SYS_mbind
+    if (node >= 0 && node < static_cast< int >(sizeof(unsigned long) * 8))
+    {
+      const int MPOL_PREFERRED_MODE = 1; // prefer the node, fall back to others when it is full
+      unsigned long mask = 1ul << node;
+      syscall(SYS_mbind, begin, length, MPOL_PREFERRED_MODE, &mask, sizeof(mask) * 8 + 1, 0); // the kernel drops the last bit of maxnode
+    }
+#endif
+    return begin;
+  }
+#endif
+};
+
+} // details
+} // logger
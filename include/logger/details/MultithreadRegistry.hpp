@@ -3,9 +3,21 @@
 #include <shared_mutex>
 #include <map>
 #include <unordered_map>
+#include <functional>
+#include <vector>
+#include <csignal>
+#include <condition_variable>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #include "logger/Registry.hpp"
 
+#include "logger/details/EmergencyFlush.hpp"
 #include "logger/details/MultithreadSinkFactory.hpp"
 
 namespace logger
@@ -20,6 +32,9 @@ private:
   //typedef std::unordered_map< std::string, LoggerPtr > LoggersMap;
 public:
   MultithreadRegistryHandle()
+    :
+    terminationTimeout(std::chrono::seconds(5)),
+    stopOverload(false)
   {
     doBreak = false;
     flushingThread = makeFlushingThread();
@@ -27,6 +42,8 @@ public:
 
   virtual ~MultithreadRegistryHandle()
   {
+    disableOverloadControl();
+    stopTerminationThread();
     doBreak = true;
     try
     {
@@ -84,25 +101,200 @@ public:
   virtual void registerLogger(LoggerPtr logger)
   {
     assert(logger);
-    mutex.lock();
+    std::lock_guard< std::shared_timed_mutex > lock(mutex);
     const auto& name = logger->getName();
     if (loggers.count(name))
     {
       throw std::runtime_error("Logger already register");
     }
+    applyConfiguration(*logger);
     loggers[name] = logger;
-    mutex.unlock();
+  }
+
+  virtual void setLevel(const std::string& name, Level level)
+  {
+    configure(name, [level](NodeConfiguration& node)
+    {
+      node.level = level;
+      node.hasLevel = true;
+    }
+    );
+  }
+
+  virtual void setAutoFlushLevel(const std::string& name, Level level)
+  {
+    configure(name, [level](NodeConfiguration& node)
+    {
+      node.autoFlushLevel = level;
+      node.hasAutoFlushLevel = true;
+    }
+    );
+  }
+
+  virtual void setSink(const std::string& name, std::shared_ptr< Sink > sink)
+  {
+    assert(sink);
+    configure(name, [&sink](NodeConfiguration& node)
+    {
+      node.sink = sink;
+    }
+    );
   }
 
   virtual std::shared_ptr< SinkFactory > getSinkFactory()
   {
     return std::make_shared< details::MultithreadSinkFactory >();
   }
+
+  /* the sinks are checked on a thread of its own, the flushing thread may be stuck in a slow sink */
+  virtual void enableOverloadControl(const OverloadPolicy& policy)
+  {
+    disableOverloadControl();
+    overload = std::make_unique< OverloadController >(policy);
+    stopOverload = false;
+    overloadThread = std::thread([this]()
+    {
+      std::unique_lock< std::mutex > lock(overloadMt);
+      while (!overloadStopped.wait_for(lock, overload->getPolicy().checkInterval, [this]() { return stopOverload; }))
+      {
+        overload->check(getLoggersList());
+      }
+      overload->restoreAll(getLoggersList());
+    }
+    );
+  }
+
+  virtual void disableOverloadControl()
+  {
+    if (!overloadThread.joinable())
+    {
+      return;
+    }
+    {
+      std::lock_guard< std::mutex > lock(overloadMt);
+      stopOverload = true;
+    }
+    overloadStopped.notify_one();
+    overloadThread.join();
+    overload.reset();
+  }
+
+  /* stops the flushing thread without waiting for it, closes every distinct sink and drains them
+   * each on its own thread; a drain still running at the deadline is left behind (detached)
+   */
+  virtual ShutdownReport shutdown(std::chrono::milliseconds timeout)
+  {
+    const auto deadline = DefaultClock::now() + timeout;
+    doBreak = true;
+
+    std::vector< std::shared_ptr< Sink > > sinks;
+    mutex.lock_shared();
+    for (auto& entry : loggers)
+    {
+      auto sink = entry.second->getSink();
+      if (std::find(sinks.begin(), sinks.end(), sink) == sinks.end())
+      {
+        sinks.push_back(sink);
+      }
+    }
+    mutex.unlock_shared();
+
+    for (auto& sink : sinks)
+    {
+      sink->close();
+    }
+
+    struct DrainState
+    {
+      std::mutex mt;
+      std::condition_variable finished;
+      std::size_t running;
+      std::uint64_t lost = 0;
+    };
+    auto state = std::make_shared< DrainState >();
+    state->running = sinks.size();
+    for (auto& sink : sinks)
+    {
+      std::thread([state, sink, deadline]()
+      {
+        const auto lost = sink->drain(deadline);
+        std::lock_guard< std::mutex > lock(state->mt);
+        state->lost += lost;
+        --state->running;
+        state->finished.notify_one();
+      }
+      ).detach();
+    }
+
+    std::unique_lock< std::mutex > lock(state->mt);
+    state->finished.wait_until(lock, deadline, [&state]() { return state->running == 0; });
+
+    ShutdownReport report;
+    report.lostMessages = state->lost;
+    report.unfinishedSinks = state->running;
+    return report;
+  }
+
+  /* SIGTERM and SIGINT only wake (async-signal-safe, through a pipe) a thread of their own, which
+   * calls shutdown(timeout) and raises the signal again with the previous disposition, so a flushing
+   * thread stuck in a sink does not hold the termination back. On Windows they set a flag checked
+   * by the flushing thread.
+   */
+  void installTerminationHandler(std::chrono::milliseconds timeout)
+  {
+    terminationTimeout = timeout;
+#ifndef _WIN32
+    if (!terminationThread.joinable())
+    {
+      auto fds = terminationPipe();
+      if (fds[0] == -1)
+      {
+        if (::pipe(fds) != 0)
+        {
+          return;
+        }
+        ::fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+        ::fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+      }
+      terminationThread = std::thread([this]() { waitForTermination(); });
+    }
+#endif
+    for (std::size_t i = 0; i < TERMINATION_SIGNAL_COUNT; ++i)
+    {
+      auto handler = std::signal(terminationSignals()[i], onTerminationSignal);
+      if (handler != onTerminationSignal)
+      {
+        previousTerminationHandlers()[i] = handler;
+      }
+    }
+  }
 private:
-  std::shared_timed_mutex mutex;
+  static const std::size_t TERMINATION_SIGNAL_COUNT = 2;
+  typedef void (*SignalHandler)(int);
+
+  /* settings given explicitly for a node of the name hierarchy */
+  struct NodeConfiguration
+  {
+    bool hasLevel = false;
+    Level level = Level::NEVER;
+    bool hasAutoFlushLevel = false;
+    Level autoFlushLevel = Level::NEVER;
+    std::shared_ptr< Sink > sink; // nullptr - not set
+  };
+  typedef std::map< std::string, NodeConfiguration > ConfigurationMap;
+
+  std::shared_timed_mutex mutex; // guards loggers and configuration
   LoggersMap loggers;
+  ConfigurationMap configuration;
   std::atomic_bool doBreak;
   std::thread flushingThread;
+  std::chrono::milliseconds terminationTimeout;
+  std::thread terminationThread; // waits for a termination signal, see installTerminationHandler()
+  std::unique_ptr< OverloadController > overload; // used by overloadThread only
+  std::thread overloadThread;
+  std::mutex overloadMt; // guards stopOverload
+  std::condition_variable overloadStopped;
+  bool stopOverload;
 
   void flushingWork()
   {
@@ -125,16 +317,223 @@ private:
 #endif
 #if 1
     mutex.lock_shared();
-    for (auto it = loggers.begin(); it != loggers.end(); ++it)
+    for (auto it = loggers.begin(); it != loggers.end() && !doBreak; ++it)
     {
       auto logger = it->second;
       logger->flush(); // flushing inside a CS may be not a good idea...
     }
     mutex.unlock_shared();
+    EpochDomain::instance().reclaim(); // releases replaced logger configurations and their sinks
     std::this_thread::yield();
 #endif
 }
 
+  /* a copy, the overload controller logs without holding the registry lock */
+  std::vector< LoggerPtr > getLoggersList()
+  {
+    std::vector< LoggerPtr > loggersList;
+    mutex.lock_shared();
+    loggersList.reserve(loggers.size());
+    for (auto& entry : loggers)
+    {
+      loggersList.push_back(entry.second);
+    }
+    mutex.unlock_shared();
+    return loggersList;
+  }
+
+  static std::string parentName(const std::string& name)
+  {
+    auto dot = name.rfind('.');
+    return dot == std::string::npos ? std::string() : name.substr(0, dot);
+  }
+
+  /* updates the node and re-resolves its whole subtree under the exclusive lock,
+   * so no logger of the subtree is registered or looked up with a stale setting
+   */
+  void configure(const std::string& name, std::function< void(NodeConfiguration&) > update)
+  {
+    std::vector< std::shared_ptr< Sink > > replacedSinks;
+    {
+      std::lock_guard< std::shared_timed_mutex > lock(mutex);
+      update(configuration[name]);
+
+      auto reconfigure = [&](Logger& logger)
+      {
+        auto previousSink = logger.getSink();
+        applyConfiguration(logger);
+        if (previousSink != logger.getSink())
+        {
+          replacedSinks.push_back(previousSink);
+        }
+      };
+
+      if (name.empty())
+      {
+        for (auto& entry : loggers)
+        {
+          reconfigure(*entry.second);
+        }
+      }
+      else
+      {
+        auto self = loggers.find(name);
+        if (self != loggers.end())
+        {
+          reconfigure(*self->second);
+        }
+
+        // descendants form a contiguous range of the ordered map, all starting with "name."
+        const auto prefix = name + '.';
+        for (auto it = loggers.lower_bound(prefix); it != loggers.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it)
+        {
+          reconfigure(*it->second);
+        }
+      }
+    }
+
+    // messages already sent to the previous sinks are not lost
+    for (auto& sink : replacedSinks)
+    {
+      sink->flush();
+    }
+  }
+
+  /* resolves the settings inherited by the logger, mutex has to be locked
+   * settings not configured anywhere up to the root are left untouched
+   */
+  void applyConfiguration(Logger& logger) const
+  {
+    NodeConfiguration resolved;
+    auto name = logger.getName();
+    for (;;)
+    {
+      auto found = configuration.find(name);
+      if (found != configuration.end())
+      {
+        const auto& node = found->second;
+        if (!resolved.hasLevel && node.hasLevel)
+        {
+          resolved.level = node.level;
+          resolved.hasLevel = true;
+        }
+        if (!resolved.hasAutoFlushLevel && node.hasAutoFlushLevel)
+        {
+          resolved.autoFlushLevel = node.autoFlushLevel;
+          resolved.hasAutoFlushLevel = true;
+        }
+        if (!resolved.sink && node.sink)
+        {
+          resolved.sink = node.sink;
+        }
+      }
+
+      if (name.empty())
+      {
+        break;
+      }
+      name = parentName(name);
+    }
+
+    // one snapshot swap, the logger never mixes old and new settings
+    logger.configure([&resolved](LoggerConfig& config)
+    {
+      if (resolved.hasLevel)
+      {
+        config.filteringLevel = resolved.level;
+      }
+      if (resolved.hasAutoFlushLevel)
+      {
+        config.autoFlushLevel = resolved.autoFlushLevel;
+      }
+      if (resolved.sink)
+      {
+        config.sink = resolved.sink;
+      }
+    }
+    );
+  }
+
+  static std::atomic< int >& terminationSignal()
+  {
+    static std::atomic< int > signal(0);
+    return signal;
+  }
+
+  static const int* terminationSignals()
+  {
+    static const int signals[TERMINATION_SIGNAL_COUNT] = { SIGTERM, SIGINT };
+    return signals;
+  }
+
+  static SignalHandler* previousTerminationHandlers()
+  {
+    static SignalHandler handlers[TERMINATION_SIGNAL_COUNT] = {};
+    return handlers;
+  }
+
+  /* the pipe waking terminationThread, process wide like the handler */
+  static int* terminationPipe()
+  {
+    static int fds[2] = { -1, -1 };
+    return fds;
+  }
+
+  static void onTerminationSignal(int signal)
+  {
+    terminationSignal().store(signal);
+#ifndef _WIN32
+    const int savedErrno = errno;
+    const char byte = static_cast< char >(signal);
+    writeRaw(terminationPipe()[1], &byte, 1);
+    errno = savedErrno;
+#endif
+  }
+
+  /* on terminationThread, a zero byte stops it */
+  void waitForTermination()
+  {
+#ifndef _WIN32
+    char byte = 0;
+    while (::read(terminationPipe()[0], &byte, 1) == -1 && errno == EINTR)
+    {
+    }
+    if (byte)
+    {
+      terminate(byte);
+    }
+#endif
+  }
+
+  void stopTerminationThread()
+  {
+    if (!terminationThread.joinable())
+    {
+      return;
+    }
+    restoreTerminationHandlers();
+    const char byte = 0;
+    writeRaw(terminationPipe()[1], &byte, 1);
+    terminationThread.join();
+  }
+
+  void restoreTerminationHandlers()
+  {
+    for (std::size_t i = 0; i < TERMINATION_SIGNAL_COUNT; ++i)
+    {
+      auto previous = previousTerminationHandlers()[i];
+      std::signal(terminationSignals()[i], previous && previous != SIG_ERR ? previous : SIG_DFL);
+    }
+  }
+
+  /* on terminationThread (the flushing thread on Windows) */
+  void terminate(int signal)
+  {
+    shutdown(terminationTimeout);
+    restoreTerminationHandlers();
+    std::raise(signal);
+  }
+
   std::thread makeFlushingThread()
   {
     std::thread thread(
@@ -143,6 +542,12 @@ private:
       while (!doBreak)
       {
         flushingWork();
+#ifdef _WIN32
+        if (const auto signal = terminationSignal().load())
+        {
+          terminate(signal);
+        }
+#endif
       }
 
     }
@@ -4,11 +4,17 @@
 #include <mutex>
 #include <vector>
 #include <algorithm>
+#include <iterator>
 #include <cassert>
 
 #include "logger/Sink.hpp"
 #include "logger/Formatter.hpp"
 
+#include "logger/details/DuplicateCollapser.hpp"
+#include "logger/details/EmergencyFlush.hpp"
+#include "logger/details/LagMeter.hpp"
+#include "logger/details/OrderedMerger.hpp"
+
 namespace logger
 {
 namespace details
@@ -24,35 +30,217 @@ public:
 
   explicit MultithreadSink(std::shared_ptr< Sink > aSink)
     :
-    internalSink(aSink)
+    internalSink(aSink),
+    closed(false),
+    rejected(0),
+    delivering(nullptr),
+    delivered(0)
   {
+    EmergencyFlush::instance().add(this);
+  }
+
+  virtual ~MultithreadSink()
+  {
+    EmergencyFlush::instance().remove(this);
+    flush();
+    std::lock_guard< std::timed_mutex > lock(flushMt);
+    merger.releaseAll(makeOutput()); // messages still held back for ordering
+    collapser.flush(*internalSink);
+    internalSink->flush();
   }
 
   virtual void send(std::unique_ptr<Message> message) override
   {
+    if (closed.load(std::memory_order_relaxed))
+    {
+      rejected.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
     std::lock_guard< std::mutex > lock(mt);
     messages.push_back(std::move(message));
   }
 
+  virtual void sendBulk(Messages& bulk) override
+  {
+    if (closed.load(std::memory_order_relaxed))
+    {
+      rejected.fetch_add(bulk.size(), std::memory_order_relaxed);
+      bulk.clear();
+      return;
+    }
+    std::lock_guard< std::mutex > lock(mt);
+    if (messages.empty())
+    {
+      messages.swap(bulk); // the caller gets the drained vector back
+    }
+    else
+    {
+      messages.insert(messages.end(), std::make_move_iterator(bulk.begin()), std::make_move_iterator(bulk.end()));
+    }
+  }
+
+  /* collapses runs of identical messages within the window, zero disables it (default) */
+  void setDuplicateWindow(DefaultClock::duration window)
+  {
+    std::lock_guard< std::timed_mutex > lock(flushMt);
+    collapser.setWindow(window);
+  }
+
+  /* delivers messages of all threads in Message::time order, holding them back for the window
+   * zero disables it (default)
+   */
+  void setOrderedDelivery(DefaultClock::duration window)
+  {
+    std::lock_guard< std::timed_mutex > lock(flushMt);
+    if (!window.count())
+    {
+      merger.releaseAll(makeOutput());
+    }
+    merger.setWindow(window);
+  }
+
   virtual void flush() override
   {
-    std::lock_guard< std::mutex > lock(flushMt);
+    std::lock_guard< std::timed_mutex > lock(flushMt);
 
     auto buffer = extractMessages();
-    std::for_each(buffer.begin(), buffer.end(),
-      [&](auto&& message)
+    if (buffer.empty())
+    {
+      lag.idle();
+    }
+    else
     {
-      internalSink->send(std::move(message));
+      lag.begin(buffer.front()->time);
     }
-    );
+    delivered.store(0, std::memory_order_relaxed);
+    delivering.store(&buffer, std::memory_order_release);
+    for (std::size_t i = 0; i < buffer.size(); ++i)
+    {
+      delivered.store(i + 1, std::memory_order_release);
+      deliver(std::move(buffer[i]));
+    }
+    delivering.store(nullptr, std::memory_order_release);
+    if (merger.isEnabled())
+    {
+      merger.release(makeOutput());
+    }
+    collapser.flush(*internalSink);
 
     internalSink->flush();
+    if (!buffer.empty())
+    {
+      lag.end();
+    }
+  }
+
+  virtual Backlog getBacklog() override
+  {
+    Backlog backlog;
+    {
+      std::lock_guard< std::mutex > lock(mt);
+      backlog.messages = messages.size();
+    }
+    backlog.lag = lag.get();
+    return backlog;
+  }
+
+  virtual void close() override
+  {
+    closed.store(true);
+    internalSink->close();
+  }
+
+  virtual std::uint64_t drain(DefaultClock::time_point deadline) override
+  {
+    std::unique_lock< std::timed_mutex > lock(flushMt, std::defer_lock);
+    if (!lock.try_lock_until(deadline))
+    {
+      // another flush is stuck, e.g. on a slow disk
+      std::lock_guard< std::mutex > messagesLock(mt);
+      return messages.size() + rejected.load();
+    }
+
+    std::uint64_t lost = 0;
+    auto buffer = extractMessages();
+    for (std::size_t i = 0; i < buffer.size(); ++i)
+    {
+      if (i % DRAIN_CHECK_INTERVAL == 0 && DefaultClock::now() >= deadline)
+      {
+        lost += buffer.size() - i;
+        break;
+      }
+      deliver(std::move(buffer[i]));
+    }
+    merger.releaseAll(makeOutput());
+    collapser.flush(*internalSink);
+
+    lost += internalSink->drain(deadline);
+    return lost + rejected.load();
+  }
+
+  /* Oldest first: the internal sink's buffers, the messages held back by the merger and
+   * the collapser (when no flush is running) or the rest of the batch being delivered, the queue.
+   * The message being delivered when the crash came, and the held back ones during a flush, are lost.
+   */
+  virtual void emergencyWrite(int fd) override
+  {
+    internalSink->emergencyWrite(fd);
+    if (flushMt.try_lock())
+    {
+      collapser.emergencyWrite(fd);
+      merger.emergencyWrite(fd);
+      flushMt.unlock();
+    }
+    else if (auto batch = delivering.load(std::memory_order_acquire))
+    {
+      for (auto i = delivered.load(std::memory_order_acquire); i < batch->size(); ++i)
+      {
+        writeRawMessage(fd, *(*batch)[i]);
+      }
+    }
+    if (mt.try_lock())
+    {
+      for (const auto& message : messages)
+      {
+        writeRawMessage(fd, *message);
+      }
+      mt.unlock();
+    }
   }
 
 private:
+  static const std::size_t DRAIN_CHECK_INTERVAL = 256; // messages delivered between deadline checks
+
   std::shared_ptr< Sink > internalSink;
+  std::atomic< bool > closed;
+  std::atomic< std::uint64_t > rejected; // sent after close()
+
+  std::timed_mutex flushMt; // only one thread can be inside flush() method at the time
+  DuplicateCollapser collapser; // guarded by flushMt
+  OrderedMerger merger;         // guarded by flushMt
+  LagMeter lag;
+  std::atomic< Messages* > delivering;   // the batch flush() is delivering, for emergencyWrite()
+  std::atomic< std::size_t > delivered;  // its messages moved out already
+
+  void deliver(std::unique_ptr< Message > message)
+  {
+    if (merger.isEnabled())
+    {
+      merger.push(std::move(message));
+    }
+    else
+    {
+      collapser.send(std::move(message), *internalSink);
+    }
+  }
 
-  std::mutex flushMt; // only one thread can be inside flush() method at the time
+  OrderedMerger::Output makeOutput()
+  {
+    return [this](std::unique_ptr< Message > message)
+    {
+      collapser.send(std::move(message), *internalSink);
+    };
+  }
 
   std::mutex mt;
   Messages messages;
@@ -7,6 +7,16 @@
 
 #include "logger/details/StandardOutputSink.hpp"
 #include "logger/details/FileSink.hpp"
+#include "logger/details/AsyncFileSink.hpp"
+#include "logger/details/BatchingSink.hpp"
+#include "logger/details/CompressedFileSink.hpp"
+#include "logger/details/ParallelFormattingSink.hpp"
+#include "logger/details/FlightRecorderSink.hpp"
+
+#ifndef _WIN32
+#include "logger/details/ConsoleSink.hpp"
+#include "logger/details/SocketSink.hpp"
+#endif
 
 #ifdef LOGGER_USE_MOODYCAMEL_CONCURRENT_QUEUE
 #include "logger/details/ConcurrentQueueSink.hpp"
@@ -33,7 +43,11 @@ public:
 
   virtual SinkPtr createStandardOutputSink(Formatter formatter)
   {
+#ifndef _WIN32
+    auto internalSink = std::make_shared< ConsoleSink >(formatter);
+#else
     auto internalSink = std::make_shared< StandardOutputSink< AtomicFlag > >(formatter);
+#endif
     return makeMultithreadSink(internalSink);
   }
 
@@ -43,6 +57,52 @@ public:
     return makeMultithreadSink(internalSink);
   }
 
+  virtual SinkPtr createIndexedFileSink(const std::string& name, Formatter formatter, std::size_t indexInterval)
+  {
+    auto internalSink = std::make_shared< FileSink >(name, formatter, indexInterval);
+    return makeMultithreadSink(internalSink);
+  }
+
+  virtual SinkPtr createAsyncFileSink(const std::string& name, Formatter formatter)
+  {
+    auto internalSink = std::make_shared< AsyncFileSink >(name, formatter);
+    return makeMultithreadSink(internalSink);
+  }
+
+  virtual SinkPtr createParallelFormattingFileSink(const std::string& name, Formatter formatter)
+  {
+    auto fileSink = std::make_shared< FileSink >(name, formatter);
+    auto internalSink = std::make_shared< ParallelFormattingSink >(fileSink, formatter);
+    return makeMultithreadSink(internalSink);
+  }
+
+  virtual SinkPtr createCompressedFileSink(const std::string& name, Formatter formatter)
+  {
+    auto internalSink = std::make_shared< CompressedFileSink >(name, formatter);
+    return makeMultithreadSink(internalSink);
+  }
+
+  virtual SinkPtr createSocketSink(const std::string& endpoint, Formatter formatter)
+  {
+#ifndef _WIN32
+    auto internalSink = std::make_shared< SocketSink >(endpoint, formatter);
+    return makeMultithreadSink(internalSink);
+#else
+    throw std::runtime_error("SocketSink is not supported on this platform");
+#endif
+  }
+
+  virtual SinkPtr createBatchingSink(SinkPtr sink)
+  {
+    return std::make_shared< BatchingSink >(sink);
+  }
+
+  virtual SinkPtr createFlightRecorderSink(const std::string& dumpFileName, Formatter formatter, Level triggerLevel)
+  {
+    auto dumpSink = std::make_shared< FileSink >(dumpFileName, formatter);
+    return std::make_shared< FlightRecorderSink >(dumpSink, triggerLevel);
+  }
+
 private:
   SinkPtr makeMultithreadSink(SinkPtr internalSink)
   {
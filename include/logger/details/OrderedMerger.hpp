@@ -0,0 +1,136 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "logger/Message.hpp"
+
+#include "logger/details/EmergencyFlush.hpp"
+
+namespace logger
+{
+namespace details
+{
+
+/* Optional stage of the multithread sinks' drain loop: restores the global Message::time order.
+ *
+ * The queues keep the order of each producer only, so messages are grouped into per-producer
+ * streams (already sorted by time) and merged with a heap. A message is released only when it
+ * is older than `window`: a message of another producer created before it may still be on its
+ * way through the queue. The window bounds the added latency, messages arriving later than
+ * the window are released as soon as possible, out of order.
+ */
+class OrderedMerger
+{
+public:
+  typedef DefaultClock::duration Duration;
+  typedef std::function< void(std::unique_ptr< Message >) > Output;
+
+  OrderedMerger()
+    :
+    window(Duration::zero()),
+    pending(0)
+  {
+  }
+
+  /* zero window disables ordering */
+  void setWindow(Duration aWindow)
+  {
+    window = aWindow;
+  }
+
+  bool isEnabled() const
+  {
+    return window != Duration::zero();
+  }
+
+  std::size_t getPendingCount() const
+  {
+    return pending;
+  }
+
+  void push(std::unique_ptr< Message > message)
+  {
+    auto& stream = streams[message->threadId];
+    if (stream.empty())
+    {
+      heap.push(HeapEntry{ message->time, &stream });
+    }
+    stream.push_back(std::move(message));
+    ++pending;
+  }
+
+  /* releases, in time order, messages older than the window */
+  void release(const Output& output)
+  {
+    releaseUntil(DefaultClock::now() - window, output);
+  }
+
+  /* releases everything, e.g. when the sink is destroyed */
+  void releaseAll(const Output& output)
+  {
+    releaseUntil(std::chrono::time_point< DefaultClock >::max(), output);
+  }
+
+  /* crash path: the held back messages, stream by stream, not merged */
+  void emergencyWrite(int fd) const
+  {
+    for (const auto& stream : streams)
+    {
+      for (const auto& message : stream.second)
+      {
+        writeRawMessage(fd, *message);
+      }
+    }
+  }
+
+private:
+  typedef std::deque< std::unique_ptr< Message > > Stream;
+
+  struct HeapEntry
+  {
+    std::chrono::time_point< DefaultClock > time; // of the stream's first message
+    Stream* stream;
+
+    bool operator>(const HeapEntry& other) const
+    {
+      return time > other.time;
+    }
+  };
+
+  Duration window;
+  std::size_t pending;
+  std::unordered_map< std::thread::id, Stream > streams; // nodes are stable, the heap keeps pointers
+  std::priority_queue< HeapEntry, std::vector< HeapEntry >, std::greater< HeapEntry > > heap; // non-empty streams
+
+  void releaseUntil(std::chrono::time_point< DefaultClock > limit, const Output& output)
+  {
+    while (!heap.empty() && heap.top().time <= limit)
+    {
+      auto& stream = *heap.top().stream;
+      heap.pop();
+
+      const auto threadId = stream.front()->threadId;
+      output(std::move(stream.front()));
+      stream.pop_front();
+      --pending;
+
+      if (!stream.empty())
+      {
+        heap.push(HeapEntry{ stream.front()->time, &stream });
+      }
+      else
+      {
+        streams.erase(threadId); // not on the heap, so producer threads which come and go do not pile up
+      }
+    }
+  }
+};
+
+} // details
+} // logger
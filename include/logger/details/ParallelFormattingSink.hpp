@@ -0,0 +1,228 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "logger/Sink.hpp"
+#include "logger/Formatter.hpp"
+
+#include "logger/details/EmergencyFlush.hpp"
+
+namespace logger
+{
+namespace details
+{
+
+/* Small fork-join pool: run() executes `work(chunk)` for every chunk on the workers and
+ * the calling thread. Chunks are claimed one by one from a shared counter, so a thread
+ * which finished its chunk takes the next unclaimed one and no thread idles while work is left.
+ */
+class FormattingPool
+{
+public:
+  explicit FormattingPool(std::size_t threadCount)
+    :
+    doBreak(false),
+    generation(0),
+    chunkCount(0),
+    nextChunk(0),
+    running(0)
+  {
+    for (std::size_t i = 0; i < threadCount; ++i)
+    {
+      threads.emplace_back([this]() { workerLoop(); });
+    }
+  }
+
+  ~FormattingPool()
+  {
+    {
+      std::lock_guard< std::mutex > lock(mt);
+      doBreak = true;
+    }
+    wakeUp.notify_all();
+    for (auto& thread : threads)
+    {
+      thread.join();
+    }
+  }
+
+  /* returns when all chunks are done, only one run() at the time */
+  void run(std::size_t chunks, std::function< void(std::size_t) > work)
+  {
+    {
+      std::lock_guard< std::mutex > lock(mt);
+      task = std::move(work);
+      chunkCount = chunks;
+      nextChunk = 0;
+      running = threads.size();
+      ++generation;
+    }
+    wakeUp.notify_all();
+
+    process();
+
+    std::unique_lock< std::mutex > lock(mt);
+    done.wait(lock, [this]() { return running == 0; });
+    task = nullptr;
+  }
+
+private:
+  std::mutex mt;
+  std::condition_variable wakeUp;
+  std::condition_variable done;
+  bool doBreak;
+  std::uint64_t generation;
+  std::function< void(std::size_t) > task;
+  std::size_t chunkCount;
+  std::atomic< std::size_t > nextChunk;
+  std::size_t running; // workers still working on the current generation
+  std::vector< std::thread > threads;
+
+  void process()
+  {
+    for (auto chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++)
+    {
+      task(chunk);
+    }
+  }
+
+  void workerLoop()
+  {
+    std::uint64_t seen = 0;
+    std::unique_lock< std::mutex > lock(mt);
+    for (;;)
+    {
+      wakeUp.wait(lock, [&]() { return doBreak || generation != seen; });
+      if (doBreak)
+      {
+        return;
+      }
+      seen = generation;
+
+      lock.unlock();
+      process();
+      lock.lock();
+
+      if (--running == 0)
+      {
+        done.notify_one();
+      }
+    }
+  }
+};
+
+/* Formats messages on several threads and writes them in the original order.
+ *
+ * Messages are only collected in send(), flush() (called after every drain of the
+ * multithread sink in front of it) splits them into chunks, formats the chunks in parallel
+ * and hands each chunk to `textSink` with its text (Sink::sendFormatted). A file sink writes
+ * the text as it is and still gets the messages, for its index and durable messages.
+ * Small batches are formatted on the calling thread. The formatter is called concurrently,
+ * so it must not modify shared state.
+ */
+class ParallelFormattingSink : public Sink
+{
+public:
+  typedef std::vector< std::unique_ptr< Message > > Messages;
+
+  static const std::size_t CHUNK_SIZE = 256;
+
+  ParallelFormattingSink(std::shared_ptr< Sink > aTextSink, Formatter _formatter,
+    std::size_t threadCount = std::max(2u, std::thread::hardware_concurrency() / 2) - 1)
+    :
+    textSink(aTextSink),
+    formatter(_formatter),
+    pool(threadCount)
+  {
+  }
+
+  virtual ~ParallelFormattingSink()
+  {
+    flush();
+  }
+
+  virtual void send(std::unique_ptr<Message> message) override
+  {
+    messages.push_back(std::move(message));
+  }
+
+  virtual void sendBulk(Messages& bulk) override
+  {
+    messages.insert(messages.end(), std::make_move_iterator(bulk.begin()), std::make_move_iterator(bulk.end()));
+  }
+
+  virtual void flush() override
+  {
+    if (!messages.empty())
+    {
+      const std::size_t chunkCount = (messages.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+      texts.resize(std::max(texts.size(), chunkCount));
+
+      auto formatChunk = [this](std::size_t chunk)
+      {
+        auto& text = texts[chunk];
+        text.clear();
+        const auto end = std::min(messages.size(), (chunk + 1) * CHUNK_SIZE);
+        for (auto index = chunk * CHUNK_SIZE; index < end; ++index)
+        {
+          text += formatter(*messages[index]);
+        }
+      };
+
+      if (chunkCount == 1)
+      {
+        formatChunk(0);
+      }
+      else
+      {
+        pool.run(chunkCount, formatChunk);
+      }
+
+      for (std::size_t chunk = 0; chunk < chunkCount; ++chunk)
+      {
+        const auto begin = messages.begin() + chunk * CHUNK_SIZE;
+        const auto end = messages.begin() + std::min(messages.size(), (chunk + 1) * CHUNK_SIZE);
+        chunkMessages.assign(std::make_move_iterator(begin), std::make_move_iterator(end));
+        textSink->sendFormatted(texts[chunk], chunkMessages);
+        chunkMessages.clear();
+      }
+      messages.clear();
+    }
+
+    textSink->flush();
+  }
+
+  /* the text sink's buffers first, then the raw messages not handed to it yet */
+  virtual void emergencyWrite(int fd) override
+  {
+    textSink->emergencyWrite(fd);
+    for (const auto& message : messages)
+    {
+      if (message)
+      {
+        writeRawMessage(fd, *message);
+      }
+    }
+  }
+
+private:
+  std::shared_ptr< Sink > textSink;
+  Formatter formatter;
+  FormattingPool pool;
+
+  Messages messages; // collected since the last flush
+  std::vector< std::string > texts; // formatted chunks
+  Messages chunkMessages;
+};
+
+} // details
+} // logger
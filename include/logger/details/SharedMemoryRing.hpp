@@ -0,0 +1,395 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace logger
+{
+namespace details
+{
+
+/* Multi producer / single consumer byte ring living in a POSIX shared memory segment.
+ *
+ * Producers (the logging process) reserve space with a CAS on `head`, copy the record
+ * and publish it by setting its state. The consumer (the collector process) reads
+ * committed records in order, zeroes them and moves `tail`.
+ * Positions are monotonic 64-bit byte counters, the physical offset is `position & mask`.
+ * A record never wraps: if it does not fit at the end of the ring, a padding record
+ * fills the rest and the record starts at offset 0.
+ * Right after the reservation a producer stamps the record with its size and pid, so the
+ * consumer can skip a record whose producer died before committing it (see recoverStalledRecord).
+ */
+class SharedMemoryRing
+{
+public:
+  static const std::uint64_t MAGIC = 0x474e49524c474f4cull; // "LOGLRING"
+  static const std::uint32_t VERSION = 2;
+  static const std::size_t MAX_PRODUCERS = 64; // processes tracked for liveness
+
+  enum State : std::uint32_t
+  {
+    EMPTY = 0,
+    COMMITTED = 1,
+    PADDING = 2
+  };
+
+  struct RecordHeader
+  {
+    std::atomic< std::uint32_t > state;
+    std::uint32_t size;               // whole record size (header included), multiple of RECORD_ALIGNMENT
+    std::atomic< std::int32_t > pid;  // of the producer, stored after `size`; 0 - not stamped yet
+    std::uint32_t reserved;
+  };
+
+  static const std::uint64_t RECORD_ALIGNMENT = sizeof(RecordHeader);
+
+  struct SegmentHeader
+  {
+    std::uint64_t magic;
+    std::atomic< std::uint32_t > initialized; // 0 - fresh segment, 1 - initializing, 2 - ready
+    std::uint32_t version;
+    std::uint64_t capacity;
+    std::atomic< std::uint32_t > untrackedProducers; // attached when `producers` was full
+    std::atomic< std::int32_t > producers[MAX_PRODUCERS]; // pids of the attached producers, 0 - free
+
+    alignas(64) std::atomic< std::uint64_t > head; // reserved by producers
+    alignas(64) std::atomic< std::uint64_t > tail; // released by the consumer
+    alignas(64) std::atomic< std::uint64_t > dropped; // records rejected because the ring was full
+  };
+
+  /* opens (or creates) the segment and maps it, the descriptor is closed right away
+   * capacity has to be a power of two; an existing segment of another capacity is refused
+   * (std::runtime_error) unless `anyExistingCapacity`, e.g. for the consumer
+   */
+  SharedMemoryRing(const std::string& name, std::uint64_t capacity, bool anyExistingCapacity = false)
+  {
+    if (capacity < 4096 || (capacity & (capacity - 1)) != 0)
+    {
+      throw std::invalid_argument("SharedMemoryRing capacity has to be a power of two (at least 4096)");
+    }
+
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd == -1)
+    {
+      throw std::runtime_error("shm_open failed for " + name);
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == -1)
+    {
+      close(fd);
+      throw std::runtime_error("fstat failed for " + name);
+    }
+
+    mappedSize = static_cast< std::size_t >(info.st_size);
+    if (mappedSize == 0)
+    {
+      mappedSize = sizeof(SegmentHeader) + capacity;
+      if (ftruncate(fd, mappedSize) == -1)
+      {
+        close(fd);
+        throw std::runtime_error("ftruncate failed for " + name);
+      }
+    }
+
+    void* address = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED)
+    {
+      throw std::runtime_error("mmap failed for " + name);
+    }
+
+    segment = static_cast< SegmentHeader* >(address);
+    data = static_cast< char* >(address) + sizeof(SegmentHeader);
+
+    try
+    {
+      initialize(mappedSize - sizeof(SegmentHeader));
+    }
+    catch (...)
+    {
+      munmap(segment, mappedSize);
+      throw;
+    }
+    if (segment->capacity != capacity && !anyExistingCapacity)
+    {
+      const auto existing = segment->capacity;
+      munmap(segment, mappedSize);
+      throw std::runtime_error("SharedMemoryRing: " + name + " exists with capacity " + std::to_string(existing)
+        + ", not " + std::to_string(capacity));
+    }
+    mask = segment->capacity - 1;
+  }
+
+  ~SharedMemoryRing()
+  {
+    munmap(segment, mappedSize);
+  }
+
+  SharedMemoryRing(const SharedMemoryRing&) = delete;
+  SharedMemoryRing& operator=(const SharedMemoryRing&) = delete;
+
+  /* removes the segment name, mapped instances stay valid */
+  static void unlink(const std::string& name)
+  {
+    shm_unlink(name.c_str());
+  }
+
+  /* registers the calling process as a producer, a slot of a dead one is reused */
+  void attachProducer()
+  {
+    const std::int32_t self = getpid();
+    for (auto& producer : segment->producers)
+    {
+      std::int32_t pid = producer.load(std::memory_order_relaxed);
+      if (pid == self)
+      {
+        return;
+      }
+      if ((pid == 0 || !isAlive(pid)) && producer.compare_exchange_strong(pid, self))
+      {
+        return;
+      }
+    }
+    segment->untrackedProducers.store(1, std::memory_order_relaxed);
+  }
+
+  std::uint64_t capacity() const
+  {
+    return segment->capacity;
+  }
+
+  std::uint64_t dropped() const
+  {
+    return segment->dropped.load(std::memory_order_relaxed);
+  }
+
+  /* Producer side: reserves `payloadSize` bytes and calls `write(char*)` to fill them.
+   * Never blocks: returns false (and counts a drop) when the ring is full.
+   */
+  template< typename WriteFunction >
+  bool push(std::size_t payloadSize, WriteFunction&& write)
+  {
+    const std::uint64_t size = align(sizeof(RecordHeader) + payloadSize);
+    if (size > segment->capacity / 2)
+    {
+      segment->dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    std::uint64_t position = segment->head.load(std::memory_order_relaxed);
+    std::uint64_t needed;
+    do
+    {
+      const std::uint64_t contiguous = segment->capacity - (position & mask);
+      needed = size <= contiguous ? size : contiguous + size;
+
+      if (position + needed - segment->tail.load(std::memory_order_acquire) > segment->capacity)
+      {
+        segment->dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+    } while (!segment->head.compare_exchange_weak(position, position + needed, std::memory_order_relaxed));
+
+    if (needed != size)
+    {
+      auto padding = header(position);
+      stamp(padding, needed - size);
+      padding->state.store(PADDING, std::memory_order_release);
+      position += needed - size;
+    }
+
+    auto record = header(position);
+    stamp(record, size);
+    write(reinterpret_cast< char* >(record + 1));
+    record->state.store(COMMITTED, std::memory_order_release);
+    return true;
+  }
+
+  /* Consumer side: delivers committed records in order to `read(const char*, size_t)`.
+   * Returns the number of delivered records. Stops at the first record which is still
+   * being written, unless its producer is gone (see recoverStalledRecord).
+   */
+  template< typename ReadFunction >
+  std::size_t pop(ReadFunction&& read, std::size_t maxRecords)
+  {
+    std::size_t count = 0;
+    std::uint64_t tail = segment->tail.load(std::memory_order_relaxed);
+    const std::uint64_t head = segment->head.load(std::memory_order_acquire);
+
+    while (tail != head && count < maxRecords)
+    {
+      auto record = header(tail);
+      const auto state = record->state.load(std::memory_order_acquire);
+      if (state == EMPTY)
+      {
+        if (!recoverStalledRecord(tail, head))
+        {
+          break;
+        }
+        continue;
+      }
+
+      stalledSince = SteadyClock::time_point();
+      const std::uint64_t size = record->size;
+      if (state == COMMITTED)
+      {
+        read(reinterpret_cast< const char* >(record + 1), size - sizeof(RecordHeader));
+        ++count;
+      }
+
+      release(tail, size);
+      tail += size;
+    }
+    return count;
+  }
+
+private:
+  typedef std::chrono::steady_clock SteadyClock;
+
+  SegmentHeader* segment = nullptr;
+  char* data = nullptr;
+  std::size_t mappedSize = 0;
+  std::uint64_t mask = 0;
+  SteadyClock::time_point stalledSince;
+
+  static std::uint64_t align(std::uint64_t size)
+  {
+    return (size + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+  }
+
+  RecordHeader* header(std::uint64_t position) const
+  {
+    return reinterpret_cast< RecordHeader* >(data + (position & mask));
+  }
+
+  void initialize(std::uint64_t capacity)
+  {
+    std::uint32_t expected = 0;
+    if (segment->initialized.compare_exchange_strong(expected, 1))
+    {
+      segment->magic = MAGIC;
+      segment->version = VERSION;
+      segment->capacity = capacity;
+      segment->untrackedProducers.store(0);
+      for (auto& producer : segment->producers)
+      {
+        producer.store(0);
+      }
+      segment->head.store(0);
+      segment->tail.store(0);
+      segment->dropped.store(0);
+      segment->initialized.store(2, std::memory_order_release);
+      return;
+    }
+
+    while (segment->initialized.load(std::memory_order_acquire) != 2)
+    {
+      std::this_thread::yield();
+    }
+    if (segment->magic != MAGIC || segment->version != VERSION)
+    {
+      throw std::runtime_error("SharedMemoryRing: incompatible segment");
+    }
+  }
+
+  /* zeroes a consumed record, so stale bytes are never taken for a record state */
+  void release(std::uint64_t position, std::uint64_t size)
+  {
+    std::memset(data + (position & mask), 0, size);
+    segment->tail.store(position + size, std::memory_order_release);
+  }
+
+  static void stamp(RecordHeader* record, std::uint64_t size)
+  {
+    record->size = static_cast< std::uint32_t >(size);
+    record->pid.store(getpid(), std::memory_order_release);
+  }
+
+  static bool isAlive(std::int32_t pid)
+  {
+    return kill(static_cast< pid_t >(pid), 0) == 0 || errno != ESRCH;
+  }
+
+  /* whether a producer which did not stamp its record yet may still be running */
+  bool anyProducerAlive() const
+  {
+    if (segment->untrackedProducers.load(std::memory_order_relaxed))
+    {
+      return true;
+    }
+    for (const auto& producer : segment->producers)
+    {
+      const auto pid = producer.load(std::memory_order_relaxed);
+      if (pid != 0 && isAlive(pid))
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /* A record reserved by a producer which died before committing it would block the ring
+   * forever, so it is skipped (and counted as dropped) once its producer is gone.
+   * A live producer, however slow or stopped, blocks the ring: its bytes are never touched.
+   * A record not stamped yet has no known size or owner: everything up to `head` is dropped,
+   * but only when no attached producer is alive, so no one is writing into it.
+   */
+  bool recoverStalledRecord(std::uint64_t& tail, std::uint64_t head)
+  {
+    if (stalledSince == SteadyClock::time_point())
+    {
+      stalledSince = SteadyClock::now();
+      return false;
+    }
+
+    auto record = header(tail);
+    const auto owner = record->pid.load(std::memory_order_acquire);
+    std::uint64_t skipped;
+    if (owner != 0)
+    {
+      const std::uint64_t size = record->size;
+      if (isAlive(owner) || size == 0 || size > head - tail)
+      {
+        return false;
+      }
+      skipped = size;
+    }
+    else
+    {
+      if (anyProducerAlive())
+      {
+        return false;
+      }
+      skipped = head - tail;
+    }
+
+    for (std::uint64_t released = 0; released < skipped; )
+    {
+      const std::uint64_t chunk = std::min(skipped - released, segment->capacity - ((tail + released) & mask));
+      std::memset(data + ((tail + released) & mask), 0, chunk);
+      released += chunk;
+    }
+    tail += skipped;
+    segment->tail.store(tail, std::memory_order_release);
+    segment->dropped.fetch_add(1, std::memory_order_relaxed);
+    stalledSince = SteadyClock::time_point();
+    return true;
+  }
+};
+
+} // details
+} // logger
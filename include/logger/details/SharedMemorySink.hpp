@@ -0,0 +1,59 @@
+#pragma once
+
+#include <memory>
+
+#include "logger/Sink.hpp"
+
+#include "logger/details/BinaryRecord.hpp"
+#include "logger/details/SharedMemoryRing.hpp"
+
+namespace logger
+{
+namespace details
+{
+
+/* Writes unformatted binary records into a shared memory ring drained by a separate
+ * collector process (see src/collector), which formats and writes them to files.
+ * Can be used directly by many producer threads: no lock, no file descriptor and no
+ * formatting on the logging side. Records are dropped (and counted in the segment)
+ * when the collector falls behind.
+ */
+class SharedMemorySink : public Sink
+{
+public:
+  static const std::uint64_t DEFAULT_CAPACITY = 64ull * 1024 * 1024;
+
+  explicit SharedMemorySink(const std::string& segmentName, std::uint64_t capacity = DEFAULT_CAPACITY)
+    :
+    ring(std::make_unique< SharedMemoryRing >(segmentName, capacity))
+  {
+    ring->attachProducer();
+  }
+
+  virtual void send(std::unique_ptr<Message> message) override
+  {
+    const auto& content = *message;
+    ring->push(binaryRecordSize(content),
+      [&content](char* buffer)
+    {
+      encodeBinaryRecord(content, buffer);
+    }
+    );
+  }
+
+  virtual void flush() override
+  {
+    // records are visible to the collector as soon as they are committed
+  }
+
+  std::uint64_t dropped() const
+  {
+    return ring->dropped();
+  }
+
+private:
+  std::unique_ptr< SharedMemoryRing > ring;
+};
+
+} // details
+} // logger
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace logger
+{
+namespace details
+{
+
+/* Socket address given as an URI:
+ *   udp://host:port, tcp://host:port, unix:///path (stream), unixgram:///path (datagram)
+ * an IPv6 address is put in brackets: tcp://[::1]:514
+ */
+struct SocketEndpoint
+{
+  enum class Protocol
+  {
+    UDP,
+    TCP,
+    UNIX_STREAM,
+    UNIX_DATAGRAM
+  };
+
+  explicit SocketEndpoint(const std::string& uri)
+  {
+    auto separator = uri.find("://");
+    if (separator == std::string::npos)
+    {
+      throw std::invalid_argument("SocketEndpoint: missing scheme in " + uri);
+    }
+
+    const auto scheme = uri.substr(0, separator);
+    const auto rest = uri.substr(separator + 3);
+    if (scheme == "udp" || scheme == "tcp")
+    {
+      protocol = scheme == "udp" ? Protocol::UDP : Protocol::TCP;
+      parseHostPort(rest);
+      if (!resolve())
+      {
+        throw std::runtime_error("SocketEndpoint: cannot resolve " + rest);
+      }
+    }
+    else if (scheme == "unix" || scheme == "unixgram")
+    {
+      protocol = scheme == "unix" ? Protocol::UNIX_STREAM : Protocol::UNIX_DATAGRAM;
+      sockaddr_un local;
+      std::memset(&local, 0, sizeof(local));
+      if (rest.size() >= sizeof(local.sun_path))
+      {
+        throw std::invalid_argument("SocketEndpoint: path too long " + rest);
+      }
+      local.sun_family = AF_UNIX;
+      std::memcpy(local.sun_path, rest.c_str(), rest.size() + 1);
+      std::memcpy(&address, &local, sizeof(local));
+      addressSize = sizeof(local);
+      path = rest;
+    }
+    else
+    {
+      throw std::invalid_argument("SocketEndpoint: unknown scheme " + scheme);
+    }
+  }
+
+  bool isStream() const
+  {
+    return protocol == Protocol::TCP || protocol == Protocol::UNIX_STREAM;
+  }
+
+  bool isInet() const
+  {
+    return protocol == Protocol::UDP || protocol == Protocol::TCP;
+  }
+
+  /* (re)resolves the host, e.g. before reconnecting to a host which may have moved
+   * returns false (the address is kept) if it fails; getaddrinfo may wait for the DNS
+   */
+  bool resolve()
+  {
+    if (!isInet())
+    {
+      return true;
+    }
+
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = protocol == Protocol::UDP ? SOCK_DGRAM : SOCK_STREAM;
+
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result) != 0 || !result)
+    {
+      return false;
+    }
+    std::memcpy(&address, result->ai_addr, result->ai_addrlen);
+    addressSize = result->ai_addrlen;
+    freeaddrinfo(result);
+    return true;
+  }
+
+  /* returns a non-blocking socket or -1 */
+  int makeSocket() const
+  {
+    int fd = socket(address.ss_family, isStream() ? SOCK_STREAM : SOCK_DGRAM, 0);
+    if (fd == -1)
+    {
+      return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    if (protocol == Protocol::TCP)
+    {
+      int on = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)); // batches are already large
+    }
+    return fd;
+  }
+
+  const sockaddr* getAddress() const
+  {
+    return reinterpret_cast< const sockaddr* >(&address);
+  }
+
+  Protocol protocol;
+  sockaddr_storage address;
+  socklen_t addressSize;
+  std::string path; // unix sockets only
+  std::string host; // udp and tcp only, without brackets
+  std::string port;
+
+private:
+  void parseHostPort(const std::string& hostPort)
+  {
+    std::string::size_type colon;
+    if (!hostPort.empty() && hostPort[0] == '[')
+    {
+      const auto closing = hostPort.find(']');
+      if (closing == std::string::npos || closing + 1 >= hostPort.size() || hostPort[closing + 1] != ':')
+      {
+        throw std::invalid_argument("SocketEndpoint: expected [address]:port in " + hostPort);
+      }
+      host = hostPort.substr(1, closing - 1);
+      colon = closing + 1;
+    }
+    else
+    {
+      colon = hostPort.rfind(':');
+      if (colon == std::string::npos)
+      {
+        throw std::invalid_argument("SocketEndpoint: missing port in " + hostPort);
+      }
+      host = hostPort.substr(0, colon);
+      if (host.find(':') != std::string::npos)
+      {
+        throw std::invalid_argument("SocketEndpoint: an IPv6 address has to be in brackets in " + hostPort);
+      }
+    }
+    port = hostPort.substr(colon + 1);
+    if (port.empty())
+    {
+      throw std::invalid_argument("SocketEndpoint: missing port in " + hostPort);
+    }
+  }
+};
+
+} // details
+} // logger
@@ -0,0 +1,313 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <string>
+#include <system_error>
+
+#include <poll.h>
+
+#include "logger/Sink.hpp"
+#include "logger/Formatter.hpp"
+
+#include "logger/details/SocketEndpoint.hpp"
+
+namespace logger
+{
+namespace details
+{
+
+struct SocketSinkOptions
+{
+  std::size_t batchSize = 60 * 1024;              // below the UDP datagram limit
+  std::size_t maxBacklog = 16 * 1024 * 1024;
+  std::chrono::steady_clock::duration minBackoff = std::chrono::milliseconds(100);
+  std::chrono::steady_clock::duration maxBackoff = std::chrono::seconds(10);
+};
+
+/* Ships formatted (or binary, see BinaryRecordFormatter) messages over UDP, TCP or unix sockets.
+ *
+ * Messages are packed into batches of up to `batchSize` bytes, one batch per datagram or
+ * write. The socket is non-blocking: batches which cannot be sent right away wait in a
+ * bounded backlog (oldest batches are dropped when it is full) and the connection is
+ * re-established with exponential backoff, so the consumer never waits for the network.
+ * After a disconnection the host is resolved again on a thread of its own, a collector behind
+ * a name which moved is found on the next attempt (destruction waits for a resolution in progress).
+ * A message is never split between datagrams.
+ */
+class SocketSink : public Sink
+{
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  typedef SocketSinkOptions Options;
+
+  SocketSink(const std::string& endpoint, Formatter _formatter, Options aOptions = Options())
+    :
+    address(endpoint),
+    formatter(_formatter),
+    options(aOptions),
+    fd(-1),
+    state(State::DISCONNECTED),
+    backoff(aOptions.minBackoff),
+    batchMessages(0),
+    backlogBytes(0),
+    droppedMessages(0)
+  {
+    batch.reserve(options.batchSize);
+  }
+
+  virtual ~SocketSink()
+  {
+    flush();
+    closeSocket();
+  }
+
+  virtual void send(std::unique_ptr<Message> message) override
+  {
+    auto text = formatter(*message);
+    if (!batch.empty() && batch.size() + text.size() > options.batchSize)
+    {
+      closeBatch();
+    }
+
+    batch += text;
+    ++batchMessages;
+    if (batch.size() >= options.batchSize)
+    {
+      closeBatch();
+    }
+  }
+
+  virtual void flush() override
+  {
+    closeBatch();
+    transmit();
+  }
+
+  std::uint64_t getDroppedCount() const
+  {
+    return droppedMessages.load(std::memory_order_relaxed);
+  }
+
+private:
+  enum class State
+  {
+    DISCONNECTED,
+    CONNECTING,
+    CONNECTED
+  };
+
+  struct Batch
+  {
+    std::string data;
+    std::size_t messages;
+    std::size_t sent; // stream sockets: bytes of `data` already written
+  };
+
+  SocketEndpoint address;
+  std::future< SocketEndpoint > resolving; // the address resolved again after a disconnection
+  Formatter formatter;
+  const Options options;
+
+  int fd;
+  State state;
+  Clock::time_point nextAttempt;
+  Clock::duration backoff;
+
+  std::string batch;
+  std::size_t batchMessages;
+  std::deque< Batch > backlog;
+  std::size_t backlogBytes;
+  std::atomic< std::uint64_t > droppedMessages;
+
+  void closeBatch()
+  {
+    if (batch.empty())
+    {
+      return;
+    }
+
+    backlogBytes += batch.size();
+    backlog.push_back(Batch{ std::move(batch), batchMessages, 0 });
+    batch.clear();
+    batch.reserve(options.batchSize);
+    batchMessages = 0;
+
+    // drop the oldest batches, but never one which is partially written
+    while (backlogBytes > options.maxBacklog && backlog.size() > 1)
+    {
+      auto oldest = backlog.begin() + (backlog.front().sent ? 1 : 0);
+      drop(oldest);
+    }
+  }
+
+  void drop(std::deque< Batch >::iterator position)
+  {
+    droppedMessages.fetch_add(position->messages, std::memory_order_relaxed);
+    backlogBytes -= position->data.size();
+    backlog.erase(position);
+  }
+
+  void transmit()
+  {
+    while (!backlog.empty() && connect())
+    {
+      auto& front = backlog.front();
+      const char* data = front.data.data() + front.sent;
+      const std::size_t size = front.data.size() - front.sent;
+
+      auto result = ::send(fd, data, size, sendFlags());
+      if (result >= 0)
+      {
+        front.sent += result;
+        if (front.sent == front.data.size() || !address.isStream())
+        {
+          backlogBytes -= front.data.size();
+          backlog.pop_front();
+        }
+        continue;
+      }
+
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+      {
+        return; // retried on the next flush
+      }
+      if (errno == EMSGSIZE)
+      {
+        drop(backlog.begin()); // a single message bigger than a datagram
+        continue;
+      }
+      disconnect();
+    }
+  }
+
+  static int sendFlags()
+  {
+#ifdef MSG_NOSIGNAL
+    return MSG_NOSIGNAL;
+#else
+    return 0;
+#endif
+  }
+
+  /* returns true when the socket is ready to send, never waits */
+  bool connect()
+  {
+    if (state == State::CONNECTED)
+    {
+      return true;
+    }
+
+    if (state == State::DISCONNECTED)
+    {
+      if (Clock::now() < nextAttempt)
+      {
+        return false;
+      }
+      if (resolving.valid())
+      {
+        if (resolving.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+          return false;
+        }
+        address = resolving.get();
+      }
+
+      fd = address.makeSocket();
+      if (fd == -1)
+      {
+        disconnect();
+        return false;
+      }
+      if (::connect(fd, address.getAddress(), address.addressSize) == 0)
+      {
+        connected();
+        return true;
+      }
+      if (errno != EINPROGRESS)
+      {
+        disconnect();
+        return false;
+      }
+      state = State::CONNECTING;
+    }
+
+    pollfd descriptor;
+    descriptor.fd = fd;
+    descriptor.events = POLLOUT;
+    descriptor.revents = 0;
+    if (poll(&descriptor, 1, 0) <= 0)
+    {
+      return false; // still connecting
+    }
+
+    int error = 0;
+    socklen_t size = sizeof(error);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &size) == -1 || error != 0)
+    {
+      disconnect();
+      return false;
+    }
+    connected();
+    return true;
+  }
+
+  void connected()
+  {
+    state = State::CONNECTED;
+    backoff = options.minBackoff;
+  }
+
+  void disconnect()
+  {
+    closeSocket();
+    nextAttempt = Clock::now() + backoff;
+    backoff = std::min(backoff * 2, options.maxBackoff);
+
+    // the rest of a partially written batch would be garbage on a new connection
+    if (!backlog.empty() && backlog.front().sent)
+    {
+      drop(backlog.begin());
+    }
+
+    if (address.isInet() && !resolving.valid())
+    {
+      try
+      {
+        resolving = std::async(std::launch::async,
+          [endpoint = address]() mutable
+        {
+          endpoint.resolve(); // keeps the old address if it fails
+          return endpoint;
+        }
+        );
+      }
+      catch (const std::system_error&)
+      {
+        // no thread for it, the old address is used
+      }
+    }
+  }
+
+  void closeSocket()
+  {
+    if (fd != -1)
+    {
+      ::close(fd);
+      fd = -1;
+    }
+    state = State::DISCONNECTED;
+  }
+};
+
+} // details
+} // logger
@@ -90,36 +90,72 @@ void runBenchmark(Function&& f, int thread_count, char const * msg)
   }
 }
 
+/* counts neighbouring lines of the file (written with TimeFormatter) out of time order */
+std::size_t countUnordered(const std::string& fileName)
+{
+  std::ifstream file(fileName);
+  std::size_t unordered = 0;
+  long long previous = 0;
+  long long time;
+  std::string rest;
+  while (file >> time && std::getline(file, rest))
+  {
+    unordered += time < previous ? 1 : 0;
+    previous = time;
+  }
+  return unordered;
+}
+
 void main()
 {
   logger::registry().registerHandle(std::make_unique< logger::details::MultithreadRegistryHandle >());
 
-  
-  auto fileSink = logger::registry()->getSinkFactory()->createFileSink("benchmark.log", logger::StandardFormatter());
+  typedef logger::details::MultithreadSinkFactory::DefinedMultitherdSink MultithreadSink;
 
-  for (auto threads : { 10 })
+  logger::Formatter timeFormatter =
+    [](const logger::Message& message)
   {
-    auto logger = std::make_shared< logger::Logger >("logger-" + std::to_string(threads));
-    logger->sink = fileSink;
-    logger->filteringLevel = logger::Level::DEBUG;
+    return std::to_string(message.time.time_since_epoch().count()) + " " + message.content + "\n";
+  };
 
-    auto benchmark = [&logger](int i, const char* msg)
+  for (auto ordered : { false, true })
+  {
+    const std::string fileName = ordered ? "benchmark-ordered.log" : "benchmark.log";
+    auto fileSink = std::make_shared< MultithreadSink >(std::make_shared< logger::details::FileSink >(fileName, timeFormatter));
+    if (ordered)
     {
-      logger->debug(logger::LOGGER_CALL_CONTEXT, [&]()->std::string
-      {
-        // will be improved
-        return "iteration #" + std::to_string(i);// +std::string(", message: ") + std::string(msg);
-      }
-      );
-    };
+      fileSink->setOrderedDelivery(std::chrono::milliseconds(10));
+    }
+    printf("\n%s delivery\n", ordered ? "ordered" : "unordered");
 
+    for (auto threads : { 10 })
+    {
+      auto logger = std::make_shared< logger::Logger >("logger-" + std::to_string(threads) + (ordered ? "-ordered" : ""));
+      logger->setSink(fileSink);
+      logger->setLevel(logger::Level::DEBUG);
+      logger::registry()->registerLogger(logger); // flushed by the registry's thread
 
-    runBenchmark(benchmark, threads, "simple");
+      auto benchmark = [&logger](int i, const char* msg)
+      {
+        logger->debug(logger::LOGGER_CALL_CONTEXT, [&]()->std::string
+        {
+          // will be improved
+          return "iteration #" + std::to_string(i);// +std::string(", message: ") + std::string(msg);
+        }
+        );
+      };
+
+      auto begin = std::chrono::high_resolution_clock::now();
+      runBenchmark(benchmark, threads, "simple");
+      logger::registry()->unregisterLogger(logger->getName());
+      logger->flush();
+      std::chrono::duration< double > total = std::chrono::high_resolution_clock::now() - begin;
+      printf("all messages written after %lfs\n", total.count());
+    }
+
+    fileSink.reset(); // releases messages held back for ordering and closes the file
+    printf("lines out of time order: %zu\n", countUnordered(fileName));
   }
 
-  //printf("waiting for to write all messages to out file...\n");
-  //logger->flush();
-  //printf("done\n");
-
   logger::registry().unregisterHandle();
 }
\ No newline at end of file
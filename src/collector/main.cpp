@@ -0,0 +1,181 @@
+#include <memory>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <csignal>
+
+#include "logger/Message.hpp"
+#include "logger/Sink.hpp"
+#include "logger/Formatter.hpp"
+#include "logger/StringHelpers.hpp"
+
+#include "logger/details/FileSink.hpp"
+#include "logger/details/BinaryRecord.hpp"
+#include "logger/details/SharedMemoryRing.hpp"
+#include "logger/details/SharedMemorySink.hpp"
+
+/*
+  Collector daemon for SharedMemorySink:
+  maps the shared memory ring, formats the records and writes them to rotated files.
+  The ring outlives the logging process, so records committed before a crash are still written.
+
+  usage: collector <segment name> <log file> [max file size in bytes] [max rotated files]
+*/
+
+using namespace logger;
+
+namespace
+{
+
+std::atomic_bool doBreak(false);
+
+void onStopSignal(int)
+{
+  doBreak = true;
+}
+
+/* FileSink with size based rotation: <name> -> <name>.1 -> ... -> <name>.<maxFiles> */
+class RotatingFileSink : public Sink
+{
+public:
+  RotatingFileSink(const std::string& aName, Formatter aFormatter, std::size_t aMaxSize, std::size_t aMaxFiles)
+    :
+    name(aName),
+    formatter(aFormatter),
+    maxSize(aMaxSize),
+    maxFiles(aMaxFiles),
+    size(0)
+  {
+    open();
+  }
+
+  virtual void send(std::unique_ptr<Message> message) override
+  {
+    message->content = formatter(*message);
+    size += message->content.size();
+    file->send(std::move(message));
+
+    if (maxSize && size >= maxSize)
+    {
+      rotate();
+    }
+  }
+
+  virtual void flush() override
+  {
+    file->flush();
+  }
+
+private:
+  std::string name;
+  Formatter formatter;
+  std::size_t maxSize;
+  std::size_t maxFiles;
+  std::size_t size;
+  std::unique_ptr< details::FileSink > file;
+
+  /* appends, a restarted collector keeps what it wrote before */
+  void open()
+  {
+    file = std::make_unique< details::FileSink >(name, StandardFormatter(), 0, true);
+    std::ifstream existing(name, std::ifstream::in | std::ifstream::binary | std::ifstream::ate);
+    const auto existingSize = existing.tellg();
+    size = existingSize > 0 ? static_cast< std::size_t >(existingSize) : 0;
+  }
+
+  void rotate()
+  {
+    file.reset(); // closes the file
+
+    for (auto index = maxFiles; index > 1; --index)
+    {
+      std::rename((name + "." + std::to_string(index - 1)).c_str(), (name + "." + std::to_string(index)).c_str());
+    }
+    if (maxFiles)
+    {
+      std::rename(name.c_str(), (name + ".1").c_str());
+    }
+    open();
+  }
+};
+
+} // anonymous
+
+int main(int argc, char* argv[])
+{
+  if (argc < 3)
+  {
+    std::cerr << "usage: " << argv[0] << " <segment name> <log file> [max file size] [max files]" << std::endl;
+    return 1;
+  }
+
+  const std::string segmentName = argv[1];
+  const std::string fileName = argv[2];
+  const std::size_t maxSize = argc > 3 ? std::stoull(argv[3]) : 0;
+  const std::size_t maxFiles = argc > 4 ? std::stoull(argv[4]) : 5;
+
+  std::signal(SIGINT, onStopSignal);
+  std::signal(SIGTERM, onStopSignal);
+
+  Formatter formatter =
+    [](const Message& message)
+  {
+    auto ns = message.time.time_since_epoch().count();
+    return string_format("%lld [%s] %s {%s:%i} %s\n",
+      static_cast< long long >(ns / 1000), // nanosec to microsec
+      message.loggerContext->name.c_str(),
+      toString(message.level),
+      message.callContext.function,
+      message.callContext.line,
+      message.content.c_str()
+    );
+  };
+
+  // attaches to a segment of any capacity, made by a producer with its own
+  details::SharedMemoryRing ring(segmentName, details::SharedMemorySink::DEFAULT_CAPACITY, true);
+  RotatingFileSink sink(fileName, formatter, maxSize, maxFiles);
+  details::MessageRebuilder rebuilder;
+
+  const std::size_t BATCH = 4096;
+  auto drain = [&]()
+  {
+    return ring.pop(
+      [&](const char* data, std::size_t size)
+    {
+      details::BinaryRecordView record;
+      if (details::decodeBinaryRecord(data, size, record))
+      {
+        sink.send(rebuilder.rebuild(record));
+      }
+    },
+      BATCH
+    );
+  };
+
+  std::uint64_t reportedDrops = 0;
+  while (!doBreak)
+  {
+    if (drain() == 0)
+    {
+      sink.flush();
+
+      auto dropped = ring.dropped();
+      if (dropped != reportedDrops)
+      {
+        std::cerr << "collector: " << dropped - reportedDrops << " records dropped by producers" << std::endl;
+        reportedDrops = dropped;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  while (drain() != 0)
+  {
+  }
+  sink.flush();
+  return 0;
+}
@@ -104,19 +104,19 @@ void main()
   //csvSink = std::make_shared< FileSink >("out.csv", csvFormatter);
 
   auto logger = std::make_shared< Logger >(DEFAULT_LOGGER_NAME);
-  //logger->sink = consoleSink;
-  logger->sink = fileSink;
-  //logger->sink = csvSink;
+  //logger->setSink(consoleSink);
+  logger->setSink(fileSink);
+  //logger->setSink(csvSink);
 
   registry()->registerLogger(logger);
 
   logger->debug(LOGGER_CALL_CONTEXT, "message 1");
 
-  logger->filteringLevel = Level::DEBUG;
+  logger->setLevel(Level::DEBUG);
   auto begin = DefaultClock::now();
   const auto THOUSAND = 1000;
   const auto MILLION = THOUSAND * THOUSAND;
-  logger->filteringLevel = Level::DEBUG;
+  logger->setLevel(Level::DEBUG);
 
   const auto ITERATIONS = 100 * THOUSAND;//MILLION;
 
@@ -0,0 +1,216 @@
+#include <memory>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logger/Message.hpp"
+#include "logger/StringHelpers.hpp"
+
+#include "logger/details/FileIndex.hpp"
+#include "logger/details/CompressedFileSink.hpp"
+
+/*
+  Range query over log files written with an index (FileSink with indexInterval, CompressedFileSink).
+  Only chunks which, according to the index, overlap the time range, contain a message at or
+  above the level and may contain messages of the logger are read (mapped, or decompressed for frames).
+  All the filters apply with the chunk granularity: the formatted text is not parsed (a layout
+  does not have to contain the level or the logger name), so a selected chunk is printed whole,
+  and the logger filter is a bloom filter, it may select a chunk without the logger.
+  The not yet indexed end of the file is always printed (the last line of a file being written
+  may be incomplete).
+
+  usage: query <log file> [--from <ticks>] [--to <ticks>] [--level <LEVEL>] [--logger <name>]
+    --from, --to  time range in DefaultClock ticks since epoch (Message::time)
+    --level       minimum level, e.g. WARNING
+    --logger      logger name
+*/
+
+using namespace logger;
+
+namespace
+{
+
+struct Options
+{
+  std::int64_t from = std::numeric_limits< std::int64_t >::min();
+  std::int64_t to = std::numeric_limits< std::int64_t >::max();
+  std::uint32_t levels = ~0u;
+  std::uint64_t loggers = 0; // loggerBits() of the logger, 0 - any
+};
+
+bool matches(const details::FileIndexEntry& entry, const Options& options)
+{
+  return details::chunkMatches(entry, options.from, options.to, options.levels, options.loggers);
+}
+
+/* read only mapping of the whole file */
+class MappedFile
+{
+public:
+  explicit MappedFile(const std::string& name)
+    :
+    data(nullptr),
+    size(0)
+  {
+    int fd = ::open(name.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+      return;
+    }
+    struct stat status;
+    if (fstat(fd, &status) == 0 && status.st_size > 0)
+    {
+      void* address = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      if (address != MAP_FAILED)
+      {
+        data = static_cast< const char* >(address);
+        size = status.st_size;
+      }
+    }
+    ::close(fd);
+  }
+
+  ~MappedFile()
+  {
+    if (data)
+    {
+      munmap(const_cast< char* >(data), size);
+    }
+  }
+
+  /* the part of the file to be read soon */
+  void willNeed(std::uint64_t begin, std::uint64_t end) const
+  {
+    const std::uint64_t page = sysconf(_SC_PAGESIZE);
+    const auto alignedBegin = begin / page * page;
+    madvise(const_cast< char* >(data) + alignedBegin, end - alignedBegin, MADV_WILLNEED);
+  }
+
+  const char* data;
+  std::uint64_t size;
+};
+
+/* FileLayout::PLAIN */
+void printLines(const std::string& name, const std::vector< details::FileIndexEntry >& entries, const Options& options)
+{
+  MappedFile file(name);
+  if (!file.data)
+  {
+    return; // empty or not readable
+  }
+
+  std::uint64_t indexedEnd = 0; // where the part of the file not covered by the index begins
+  for (const auto& entry : entries)
+  {
+    const auto end = entry.offset + entry.size;
+    if (end > file.size)
+    {
+      break;
+    }
+    indexedEnd = end;
+    if (matches(entry, options))
+    {
+      file.willNeed(entry.offset, end);
+      std::cout.write(file.data + entry.offset, entry.size);
+    }
+  }
+
+  // the end of the file written after the last index entry
+  std::cout.write(file.data + indexedEnd, file.size - indexedEnd);
+}
+
+/* FileLayout::FRAMES */
+void printFrames(const std::string& name, const std::vector< details::FileIndexEntry >& entries, const Options& options)
+{
+  std::ifstream file(name, std::ifstream::in | std::ifstream::binary);
+  std::vector< char > buffer;
+  std::string text;
+
+  std::uint64_t next = 0; // where the part of the file not covered by the index begins
+  for (const auto& entry : entries)
+  {
+    if (!matches(entry, options))
+    {
+      next = entry.offset + entry.size;
+      continue;
+    }
+    if (details::readFrame(file, entry.offset, next, buffer, text) != details::FrameRead::OK)
+    {
+      return; // indexed, but not written completely yet
+    }
+    std::cout.write(text.data(), text.size());
+  }
+
+  // frames written after the last index entry, up to the end of the file
+  while (details::readFrame(file, next, next, buffer, text) == details::FrameRead::OK)
+  {
+    std::cout.write(text.data(), text.size());
+  }
+}
+
+} // anonymous
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "usage: " << argv[0] << " <log file> [--from <ticks>] [--to <ticks>] [--level <LEVEL>] [--logger <name>]" << std::endl;
+    return 1;
+  }
+
+  Options options;
+  for (int i = 2; i + 1 < argc; i += 2)
+  {
+    const std::string argument = argv[i];
+    if (argument == "--from")
+    {
+      options.from = std::stoll(argv[i + 1]);
+    }
+    else if (argument == "--to")
+    {
+      options.to = std::stoll(argv[i + 1]);
+    }
+    else if (argument == "--level")
+    {
+      Level level;
+      if (!parseLevel(argv[i + 1], level))
+      {
+        std::cerr << "unknown level " << argv[i + 1] << std::endl;
+        return 1;
+      }
+      options.levels = details::levelsAtOrAbove(level);
+    }
+    else if (argument == "--logger")
+    {
+      options.loggers = details::loggerBits(argv[i + 1]);
+    }
+  }
+
+  details::FileIndexHeader header;
+  std::vector< details::FileIndexEntry > entries;
+  if (!details::readFileIndex(argv[1], header, entries))
+  {
+    std::cerr << "missing or unsupported index " << details::indexFileName(argv[1]) << std::endl;
+    return 1;
+  }
+
+  if (header.layout == details::FileLayout::FRAMES)
+  {
+    printFrames(argv[1], entries, options);
+  }
+  else
+  {
+    printLines(argv[1], entries, options);
+  }
+  return 0;
+}
@@ -0,0 +1,126 @@
+#include <memory>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <cstdint>
+#include <limits>
+
+#include "logger/Message.hpp"
+#include "logger/StringHelpers.hpp"
+
+#include "logger/details/FileIndex.hpp"
+#include "logger/details/CompressedFileSink.hpp"
+
+/*
+  Reader of files written by CompressedFileSink:
+  decompresses only the frames which, according to the index, overlap the time range
+  and contain a message at or above the level, and writes them to the standard output.
+  Without the index all frames are read.
+
+  usage: reader <log file> [--from <ticks>] [--to <ticks>] [--level <LEVEL>]
+    --from, --to  time range in DefaultClock ticks since epoch (Message::time)
+    --level       minimum level, e.g. WARNING
+*/
+
+using namespace logger;
+
+namespace
+{
+
+struct Options
+{
+  std::int64_t from = std::numeric_limits< std::int64_t >::min();
+  std::int64_t to = std::numeric_limits< std::int64_t >::max();
+  std::uint32_t levels = ~0u;
+};
+
+/* prints the frame at the offset, returns false at the end of the file or on error */
+bool printFrame(std::ifstream& file, std::uint64_t offset, std::uint64_t& next, std::vector< char >& buffer, std::string& text)
+{
+  const auto result = details::readFrame(file, offset, next, buffer, text);
+  if (result == details::FrameRead::MALFORMED)
+  {
+    std::cerr << "malformed frame at offset " << offset << std::endl;
+  }
+  if (result != details::FrameRead::OK)
+  {
+    return false;
+  }
+
+  std::cout.write(text.data(), text.size());
+  return true;
+}
+
+} // anonymous
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "usage: " << argv[0] << " <log file> [--from <ticks>] [--to <ticks>] [--level <LEVEL>]" << std::endl;
+    return 1;
+  }
+
+  Options options;
+  for (int i = 2; i + 1 < argc; i += 2)
+  {
+    const std::string argument = argv[i];
+    if (argument == "--from")
+    {
+      options.from = std::stoll(argv[i + 1]);
+    }
+    else if (argument == "--to")
+    {
+      options.to = std::stoll(argv[i + 1]);
+    }
+    else if (argument == "--level")
+    {
+      Level level;
+      if (!parseLevel(argv[i + 1], level))
+      {
+        std::cerr << "unknown level " << argv[i + 1] << std::endl;
+        return 1;
+      }
+      options.levels = details::levelsAtOrAbove(level);
+    }
+  }
+
+  std::ifstream file(argv[1], std::ifstream::in | std::ifstream::binary);
+  if (!file)
+  {
+    std::cerr << "cannot open " << argv[1] << std::endl;
+    return 1;
+  }
+
+  std::vector< char > buffer;
+  std::string text;
+  std::uint64_t next = 0;
+
+  details::FileIndexHeader header;
+  std::vector< details::FileIndexEntry > entries;
+  if (!details::readFileIndex(argv[1], header, entries) || header.layout != details::FileLayout::FRAMES)
+  {
+    std::cerr << "no index, reading all frames" << std::endl;
+    while (printFrame(file, next, next, buffer, text))
+    {
+    }
+    return 0;
+  }
+
+  for (const auto& entry : entries)
+  {
+    if (details::chunkMatches(entry, options.from, options.to, options.levels) && !printFrame(file, entry.offset, next, buffer, text))
+    {
+      return 1;
+    }
+  }
+
+  // frames written after the last index entry (the file is still being written) are not filtered
+  next = entries.empty() ? 0 : entries.back().offset + entries.back().size;
+  while (printFrame(file, next, next, buffer, text))
+  {
+  }
+  return 0;
+}
@@ -0,0 +1,271 @@
+#include <memory>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <iostream>
+#include <cstdint>
+#include <cerrno>
+#include <cstring>
+#include <csignal>
+
+#include <poll.h>
+#include <unistd.h>
+
+#include "logger/details/BinaryRecord.hpp"
+#include "logger/details/SocketEndpoint.hpp"
+
+/*
+  Minimal local stand-in for a log collector, for tests and benchmarks of SocketSink.
+  Listens on the endpoint, counts received messages and bytes and reports the throughput.
+
+  usage: receiver <endpoint> [--binary] [--print] [--expect <messages>]
+    --binary   messages are length prefixed binary records (BinaryRecordFormatter), text lines otherwise
+    --print    prints every received message to the standard output
+    --expect   exits after receiving the given number of messages
+*/
+
+using namespace logger;
+
+namespace
+{
+
+std::atomic_bool doBreak(false);
+
+void onStopSignal(int)
+{
+  doBreak = true;
+}
+
+struct Options
+{
+  bool binary = false;
+  bool print = false;
+  std::uint64_t expected = 0;
+};
+
+struct Statistics
+{
+  std::uint64_t messages = 0;
+  std::uint64_t bytes = 0;
+  std::uint64_t malformed = 0;
+};
+
+/* splits received data into messages, keeps an incomplete tail for stream connections */
+class Parser
+{
+public:
+  Parser(const Options& aOptions, Statistics& aStatistics)
+    :
+    options(aOptions),
+    statistics(aStatistics)
+  {
+  }
+
+  void feed(const char* data, std::size_t size, bool datagram)
+  {
+    statistics.bytes += size;
+    pending.append(data, size);
+
+    std::size_t used = options.binary ? parseRecords() : parseLines();
+    pending.erase(0, used);
+
+    if (datagram && !pending.empty())
+    {
+      // datagrams always carry whole messages
+      ++statistics.malformed;
+      pending.clear();
+    }
+  }
+
+private:
+  const Options& options;
+  Statistics& statistics;
+  std::string pending;
+
+  std::size_t parseLines()
+  {
+    std::size_t begin = 0;
+    std::size_t end;
+    while ((end = pending.find('\n', begin)) != std::string::npos)
+    {
+      if (options.print)
+      {
+        std::cout.write(pending.data() + begin, end - begin + 1);
+      }
+      ++statistics.messages;
+      begin = end + 1;
+    }
+    return begin;
+  }
+
+  std::size_t parseRecords()
+  {
+    std::size_t begin = 0;
+    while (pending.size() - begin >= sizeof(std::uint32_t))
+    {
+      std::uint32_t size;
+      std::memcpy(&size, pending.data() + begin, sizeof(size));
+      if (pending.size() - begin - sizeof(size) < size)
+      {
+        break;
+      }
+
+      details::BinaryRecordView record;
+      if (details::decodeBinaryRecord(pending.data() + begin + sizeof(size), size, record))
+      {
+        if (options.print)
+        {
+          std::cout << record.header.time << " [" << std::string(record.logger, record.header.loggerSize) << "] "
+            << std::string(record.content, record.header.contentSize) << "\n";
+        }
+        ++statistics.messages;
+      }
+      else
+      {
+        ++statistics.malformed;
+      }
+      begin += sizeof(size) + size;
+    }
+    return begin;
+  }
+};
+
+int openListeningSocket(const details::SocketEndpoint& endpoint)
+{
+  if (!endpoint.path.empty())
+  {
+    ::unlink(endpoint.path.c_str());
+  }
+
+  int fd = endpoint.makeSocket();
+  if (fd == -1)
+  {
+    return -1;
+  }
+
+  int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  if (bind(fd, endpoint.getAddress(), endpoint.addressSize) == -1
+    || (endpoint.isStream() && listen(fd, 16) == -1))
+  {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+} // anonymous
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2)
+  {
+    std::cerr << "usage: " << argv[0] << " <endpoint> [--binary] [--print] [--expect <messages>]" << std::endl;
+    return 1;
+  }
+
+  Options options;
+  for (int i = 2; i < argc; ++i)
+  {
+    const std::string argument = argv[i];
+    if (argument == "--binary")
+    {
+      options.binary = true;
+    }
+    else if (argument == "--print")
+    {
+      options.print = true;
+    }
+    else if (argument == "--expect" && i + 1 < argc)
+    {
+      options.expected = std::stoull(argv[++i]);
+    }
+  }
+
+  std::signal(SIGINT, onStopSignal);
+  std::signal(SIGTERM, onStopSignal);
+
+  details::SocketEndpoint endpoint(argv[1]);
+  int listening = openListeningSocket(endpoint);
+  if (listening == -1)
+  {
+    std::cerr << "cannot listen on " << argv[1] << std::endl;
+    return 1;
+  }
+
+  Statistics statistics;
+  std::vector< pollfd > descriptors(1, pollfd{ listening, POLLIN, 0 });
+  std::vector< std::unique_ptr< Parser > > parsers;
+  parsers.push_back(std::make_unique< Parser >(options, statistics));
+
+  std::vector< char > buffer(256 * 1024);
+  auto begin = std::chrono::steady_clock::now();
+  auto lastReport = begin;
+  std::uint64_t reportedMessages = 0;
+
+  while (!doBreak && (!options.expected || statistics.messages < options.expected))
+  {
+    if (poll(descriptors.data(), descriptors.size(), 100) < 0)
+    {
+      continue;
+    }
+
+    for (std::size_t i = 0; i < descriptors.size(); ++i)
+    {
+      if (!(descriptors[i].revents & (POLLIN | POLLHUP | POLLERR)))
+      {
+        continue;
+      }
+
+      if (i == 0 && endpoint.isStream())
+      {
+        int connection = accept(listening, nullptr, nullptr);
+        if (connection != -1)
+        {
+          descriptors.push_back(pollfd{ connection, POLLIN, 0 });
+          parsers.push_back(std::make_unique< Parser >(options, statistics));
+        }
+        continue;
+      }
+
+      auto received = ::recv(descriptors[i].fd, buffer.data(), buffer.size(), 0);
+      if (received > 0)
+      {
+        parsers[i]->feed(buffer.data(), received, !endpoint.isStream());
+      }
+      else if (i != 0 && (received == 0 || (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)))
+      {
+        // closed by the peer or failed (e.g. reset)
+        ::close(descriptors[i].fd);
+        descriptors.erase(descriptors.begin() + i);
+        parsers.erase(parsers.begin() + i);
+        --i;
+      }
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastReport >= std::chrono::seconds(1))
+    {
+      std::chrono::duration< double > elapsed = now - lastReport;
+      std::cerr << "received " << statistics.messages << " messages, "
+        << (statistics.messages - reportedMessages) / elapsed.count() << " msg/s" << std::endl;
+      reportedMessages = statistics.messages;
+      lastReport = now;
+    }
+  }
+
+  std::chrono::duration< double > total = std::chrono::steady_clock::now() - begin;
+  std::cerr << "total: " << statistics.messages << " messages, " << statistics.bytes << " bytes, "
+    << statistics.malformed << " malformed in " << total.count() << " sec" << std::endl;
+
+  for (auto& descriptor : descriptors)
+  {
+    ::close(descriptor.fd);
+  }
+  if (!endpoint.path.empty())
+  {
+    ::unlink(endpoint.path.c_str());
+  }
+  return 0;
+}
@@ -0,0 +1,749 @@
+#include <memory>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <iostream>
+#include <fstream>
+#include <cstdint>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+
+#include <unistd.h>
+
+#include "logger/Message.hpp"
+#include "logger/Sink.hpp"
+#include "logger/Logger.hpp"
+#include "logger/Registry.hpp"
+
+#include "logger/details/MultithreadRegistry.hpp"
+#include "logger/details/MultithreadSink.hpp"
+#include "logger/details/BatchingSink.hpp"
+#include "logger/details/FileSink.hpp"
+#ifdef LOGGER_USE_MOODYCAMEL_CONCURRENT_QUEUE
+#include "logger/details/ConcurrentQueueSink.hpp"
+#endif
+
+/*
+  Soak and fault injection test of the multithread sinks.
+  Producer threads log sequence numbered messages through a multithread sink variant into
+  a FaultInjectingSink, a stand-in for a file on a degraded disk: slow writes, a throughput cap,
+  failing writes (ENOSPC, EIO) and partial writes. The bytes "written" are parsed back and checked:
+   - every message sent is delivered exactly once and in its producer's order, or shed by the
+     overload control (OverloadController), or lost in a failed write the sink reported,
+   - the peak resident memory stays below --max-rss-mb,
+  and the latency of the producers' log calls is reported as percentiles.
+  The "file-full" variant writes through FileSink to /dev/full and checks that the errors are reported.
+  Exits with 1 if a check fails.
+
+  usage: soak [--variant <name>|all] [--duration <seconds>] [--threads <n>] [--rate <messages/s per thread>]
+              [--latency-us <n>] [--throughput <bytes/s>] [--fail-rate <0..1>] [--partial-rate <0..1>]
+              [--max-rss-mb <n>] [--report <seconds>] [--seed <n>] [--no-overload-control]
+    --variant     mutex, mutex-batching, concurrent-queue, concurrent-queue-batching, file-full (default all)
+    --duration    of each variant (default 60), hours-long runs are the point
+    --rate        0 - as fast as possible (default)
+    --latency-us  added to every write (default 200), --throughput 0 - unlimited (default 50 MB/s)
+    --fail-rate, --partial-rate  probability of a write failing or writing only a part (default 0.001, 0.01)
+*/
+
+using namespace logger;
+
+namespace
+{
+
+struct Options
+{
+  std::string variant = "all";
+  std::chrono::seconds duration = std::chrono::seconds(60);
+  unsigned int threads = 4;
+  std::uint64_t rate = 0;
+  std::chrono::microseconds latency = std::chrono::microseconds(200);
+  std::uint64_t throughput = 50 * 1024 * 1024;
+  double failRate = 0.001;
+  double partialRate = 0.01;
+  std::size_t maxRssMb = 1024;
+  std::chrono::seconds report = std::chrono::seconds(10);
+  std::uint64_t seed = 1;
+  bool overloadControl = true;
+};
+
+/* resident set size of the process, 0 if not known */
+std::size_t residentBytes()
+{
+  std::ifstream statm("/proc/self/statm");
+  std::size_t size = 0;
+  std::size_t resident = 0;
+  if (!(statm >> size >> resident))
+  {
+    return 0;
+  }
+  return resident * static_cast< std::size_t >(::sysconf(_SC_PAGESIZE));
+}
+
+/* log-linear buckets: 16 per power of two, about 6% resolution */
+class LatencyHistogram
+{
+public:
+  LatencyHistogram()
+    :
+    buckets(BUCKET_COUNT, 0),
+    count(0),
+    maximum(0)
+  {
+  }
+
+  void add(std::uint64_t nanoseconds)
+  {
+    ++buckets[bucketOf(nanoseconds)];
+    ++count;
+    maximum = std::max(maximum, nanoseconds);
+  }
+
+  void merge(const LatencyHistogram& other)
+  {
+    for (std::size_t i = 0; i < BUCKET_COUNT; ++i)
+    {
+      buckets[i] += other.buckets[i];
+    }
+    count += other.count;
+    maximum = std::max(maximum, other.maximum);
+  }
+
+  /* lower bound of the bucket holding the percentile */
+  std::uint64_t percentile(double percent) const
+  {
+    const auto rank = static_cast< std::uint64_t >(count * percent / 100.);
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < BUCKET_COUNT; ++i)
+    {
+      seen += buckets[i];
+      if (seen > rank)
+      {
+        return lowerBound(i);
+      }
+    }
+    return maximum;
+  }
+
+  std::uint64_t getCount() const
+  {
+    return count;
+  }
+
+  std::uint64_t getMaximum() const
+  {
+    return maximum;
+  }
+
+private:
+  static const std::size_t SUB_BUCKETS = 16;
+  static const std::size_t BUCKET_COUNT = 64 * SUB_BUCKETS;
+
+  std::vector< std::uint64_t > buckets;
+  std::uint64_t count;
+  std::uint64_t maximum;
+
+  static std::size_t bucketOf(std::uint64_t value)
+  {
+    if (value < SUB_BUCKETS)
+    {
+      return static_cast< std::size_t >(value);
+    }
+    const std::size_t magnitude = 63 - __builtin_clzll(value); // >= 4
+    const std::size_t sub = static_cast< std::size_t >(value >> (magnitude - 4)) & (SUB_BUCKETS - 1);
+    return (magnitude - 3) * SUB_BUCKETS + sub;
+  }
+
+  static std::uint64_t lowerBound(std::size_t bucket)
+  {
+    if (bucket < SUB_BUCKETS)
+    {
+      return bucket;
+    }
+    const std::size_t magnitude = bucket / SUB_BUCKETS + 3;
+    return (SUB_BUCKETS + bucket % SUB_BUCKETS) << (magnitude - 4);
+  }
+};
+
+/* 4 hex digits appended to every line, a truncated line does not pass */
+std::string checksum(const char* data, std::size_t size)
+{
+  std::uint32_t hash = 2166136261u;
+  for (std::size_t i = 0; i < size; ++i)
+  {
+    hash = (hash ^ static_cast< unsigned char >(data[i])) * 16777619u;
+  }
+  char text[5];
+  std::snprintf(text, sizeof(text), "%04x", static_cast< unsigned int >(hash & 0xffff));
+  return text;
+}
+
+/* Parses the bytes written back into lines "<producer> <sequence> <checksum>" and checks the
+ * sequences. Memory is bounded: only the next expected sequence of each producer is kept.
+ */
+class Verifier
+{
+public:
+  explicit Verifier(unsigned int producers)
+    :
+    expected(producers, 0),
+    delivered(0),
+    gaps(0),
+    duplicates(0),
+    truncated(0),
+    others(0)
+  {
+  }
+
+  void consume(const char* data, std::size_t size)
+  {
+    for (std::size_t i = 0; i < size; ++i)
+    {
+      if (data[i] != '\n')
+      {
+        line.push_back(data[i]);
+        continue;
+      }
+      checkLine();
+      line.clear();
+    }
+  }
+
+  /* the last line, if the file does not end with '\n' */
+  void finish()
+  {
+    if (!line.empty())
+    {
+      checkLine();
+      line.clear();
+    }
+  }
+
+  /* sequences never delivered, after the producers stopped; `sent` - per producer */
+  std::uint64_t missing(const std::vector< std::uint64_t >& sent) const
+  {
+    std::uint64_t result = gaps;
+    for (std::size_t producer = 0; producer < expected.size(); ++producer)
+    {
+      result += sent[producer] - std::min(sent[producer], expected[producer]);
+    }
+    return result;
+  }
+
+  std::uint64_t getDelivered() const { return delivered; }
+  std::uint64_t getDuplicates() const { return duplicates; }
+  std::uint64_t getTruncated() const { return truncated; }
+  std::uint64_t getOthers() const { return others; }
+
+private:
+  std::vector< std::uint64_t > expected; // next sequence of each producer
+  std::string line;
+  std::uint64_t delivered;
+  std::uint64_t gaps;       // sequences skipped: shed or lost
+  std::uint64_t duplicates; // or out of order
+  std::uint64_t truncated;  // by a failed write
+  std::uint64_t others;     // not a producer's, e.g. the overload transitions
+
+  void checkLine()
+  {
+    const auto space = line.rfind(' ');
+    if (space == std::string::npos || line.size() - space != 5 || checksum(line.data(), space) != line.substr(space + 1))
+    {
+      ++truncated;
+      return;
+    }
+
+    unsigned int producer;
+    unsigned long long sequence;
+    if (std::sscanf(line.c_str(), "%u %llu", &producer, &sequence) != 2 || producer >= expected.size())
+    {
+      ++others;
+      std::cout << "  | " << line.substr(0, space) << std::endl;
+      return;
+    }
+
+    auto& next = expected[producer];
+    if (sequence < next)
+    {
+      ++duplicates;
+      return;
+    }
+    gaps += sequence - next;
+    next = sequence + 1;
+    ++delivered;
+  }
+};
+
+struct FaultOptions
+{
+  std::chrono::microseconds latency;
+  std::uint64_t throughput; // bytes per second, 0 - unlimited
+  double failRate;
+  double partialRate;
+  std::uint64_t seed;
+  std::size_t bufferSize = 64 * 1024;
+};
+
+/* Stand-in for a file on a degraded disk, behind a multithread sink (used by one thread at a time).
+ * Formatted lines are buffered and written with a simulated write(2): it sleeps for the latency
+ * and the throughput cap, fails with ENOSPC or EIO, or writes only a part (the rest is written
+ * again, like a correct writer does). The bytes of a failed write are dropped and the messages
+ * not written completely are counted as lost. A line cut by a failure is terminated by the next
+ * successful write, so the following lines stay intact.
+ */
+class FaultInjectingSink : public Sink
+{
+public:
+  FaultInjectingSink(const FaultOptions& aOptions, Verifier& aVerifier)
+    :
+    options(aOptions),
+    verifier(aVerifier),
+    random(aOptions.seed),
+    lineOpen(false),
+    writes(0),
+    noSpaceErrors(0),
+    ioErrors(0),
+    partialWrites(0),
+    lost(0),
+    lostOthers(0)
+  {
+  }
+
+  virtual void send(std::unique_ptr< Message > message) override
+  {
+    pending += message->content;
+    pending += ' ';
+    pending += checksum(message->content.data(), message->content.size());
+    pending += '\n';
+    if (pending.size() >= options.bufferSize)
+    {
+      writePending();
+    }
+  }
+
+  virtual void flush() override
+  {
+    writePending();
+  }
+
+  std::uint64_t getWrites() const { return writes; }
+  std::uint64_t getNoSpaceErrors() const { return noSpaceErrors; }
+  std::uint64_t getIoErrors() const { return ioErrors; }
+  std::uint64_t getPartialWrites() const { return partialWrites; }
+  std::uint64_t getLost() const { return lost; }
+  std::uint64_t getLostOthers() const { return lostOthers; }
+
+private:
+  const FaultOptions options;
+  Verifier& verifier;
+  std::mt19937_64 random;
+  std::uniform_real_distribution< double > chance;
+
+  std::string pending;
+  bool lineOpen; // the last line written was cut by a failure
+
+  std::uint64_t writes;
+  std::uint64_t noSpaceErrors;
+  std::uint64_t ioErrors;
+  std::uint64_t partialWrites;
+  std::uint64_t lost;       // producers' messages
+  std::uint64_t lostOthers; // e.g. the overload transitions
+
+  void writePending()
+  {
+    if (pending.empty() && !lineOpen)
+    {
+      return;
+    }
+
+    if (lineOpen)
+    {
+      if (simulatedWrite("\n", 1) != 1)
+      {
+        dropPending(0);
+        return;
+      }
+      lineOpen = false;
+    }
+
+    std::size_t written = 0;
+    while (written < pending.size())
+    {
+      const auto result = simulatedWrite(pending.data() + written, pending.size() - written);
+      if (result < 0)
+      {
+        dropPending(written);
+        return;
+      }
+      written += static_cast< std::size_t >(result);
+    }
+    pending.clear();
+  }
+
+  /* after a failure, `written` bytes of pending made it */
+  void dropPending(std::size_t written)
+  {
+    // a line is lost unless its content was written completely (only the '\n' missing)
+    auto begin = written ? pending.rfind('\n', written - 1) : std::string::npos;
+    begin = begin == std::string::npos ? 0 : begin + 1;
+    while (begin < pending.size())
+    {
+      const auto end = pending.find('\n', begin);
+      if (end > written)
+      {
+        ++(std::isdigit(static_cast< unsigned char >(pending[begin])) ? lost : lostOthers);
+      }
+      begin = end + 1;
+    }
+    lineOpen = lineOpen || (written > 0 && pending[written - 1] != '\n');
+    pending.clear();
+  }
+
+  /* returns the number of bytes written or -1, like write(2) */
+  long simulatedWrite(const char* data, std::size_t size)
+  {
+    ++writes;
+    auto delay = std::chrono::duration< double, std::micro >(options.latency);
+    if (options.throughput)
+    {
+      delay += std::chrono::duration< double, std::micro >(1e6 * size / options.throughput);
+    }
+    std::this_thread::sleep_for(delay);
+
+    const auto roll = chance(random);
+    if (roll < options.failRate)
+    {
+      // the disk fills up or fails, the sink has to cope with both
+      ++(roll < options.failRate / 2 ? noSpaceErrors : ioErrors);
+      return -1;
+    }
+    if (roll < options.failRate + options.partialRate && size > 1)
+    {
+      ++partialWrites;
+      size = 1 + static_cast< std::size_t >(random() % (size - 1));
+    }
+    verifier.consume(data, size);
+    return static_cast< long >(size);
+  }
+};
+
+typedef std::shared_ptr< Sink > SinkPtr;
+
+/* the multithread sink of the variant over `internalSink`, nullptr for an unknown variant */
+SinkPtr makeVariant(const std::string& variant, SinkPtr internalSink)
+{
+  if (variant == "mutex")
+  {
+    return std::make_shared< details::MultithreadSink >(internalSink);
+  }
+  if (variant == "mutex-batching")
+  {
+    return std::make_shared< details::BatchingSink >(std::make_shared< details::MultithreadSink >(internalSink));
+  }
+#ifdef LOGGER_USE_MOODYCAMEL_CONCURRENT_QUEUE
+  if (variant == "concurrent-queue")
+  {
+    return std::make_shared< details::ConcurrentQueueSink >(internalSink);
+  }
+  if (variant == "concurrent-queue-batching")
+  {
+    return std::make_shared< details::BatchingSink >(std::make_shared< details::ConcurrentQueueSink >(internalSink));
+  }
+#endif
+  return nullptr;
+}
+
+std::vector< std::string > variants()
+{
+  return {
+    "mutex", "mutex-batching",
+#ifdef LOGGER_USE_MOODYCAMEL_CONCURRENT_QUEUE
+    "concurrent-queue", "concurrent-queue-batching",
+#endif
+    "file-full" };
+}
+
+double toMilliseconds(DefaultClock::duration duration)
+{
+  return std::chrono::duration< double, std::milli >(duration).count();
+}
+
+/* producers log for options.duration, returns false if a check failed */
+bool soak(const std::string& variant, const Options& options)
+{
+  std::cout << "--- " << variant << " ---" << std::endl;
+
+  Verifier verifier(options.threads);
+  FaultOptions faults;
+  faults.latency = options.latency;
+  faults.throughput = options.throughput;
+  faults.failRate = options.failRate;
+  faults.partialRate = options.partialRate;
+  faults.seed = options.seed;
+  auto faultSink = std::make_shared< FaultInjectingSink >(faults, verifier);
+
+  auto sink = makeVariant(variant, faultSink);
+  if (!sink)
+  {
+    std::cerr << "unknown variant " << variant << std::endl;
+    return false;
+  }
+
+  registry().registerHandle(std::make_unique< details::MultithreadRegistryHandle >());
+  if (options.overloadControl)
+  {
+    OverloadPolicy policy;
+    policy.highWatermark = 200000;
+    policy.lowWatermark = 20000;
+    registry()->enableOverloadControl(policy);
+  }
+
+  auto soakLogger = std::make_shared< Logger >("soak." + variant);
+  soakLogger->setSink(sink);
+  soakLogger->setLevel(Level::INFO);
+  registry()->registerLogger(soakLogger); // flushed by the registry's thread
+
+  std::atomic< bool > stop(false);
+  std::vector< std::uint64_t > sent(options.threads, 0);
+  std::vector< LatencyHistogram > latencies(options.threads);
+  std::vector< std::thread > producers;
+  for (unsigned int producer = 0; producer < options.threads; ++producer)
+  {
+    producers.emplace_back([&, producer]()
+    {
+      const auto begin = DefaultClock::now();
+      auto& sequence = sent[producer];
+      auto& histogram = latencies[producer];
+      while (!stop.load(std::memory_order_relaxed))
+      {
+        auto content = std::to_string(producer) + " " + std::to_string(sequence);
+        const auto before = DefaultClock::now();
+        soakLogger->info(LOGGER_CALL_CONTEXT, std::move(content));
+        histogram.add(std::chrono::duration_cast< std::chrono::nanoseconds >(DefaultClock::now() - before).count());
+        ++sequence;
+
+        if (options.rate && sequence % 64 == 0)
+        {
+          const auto due = begin + std::chrono::nanoseconds(sequence * 1000000000ull / options.rate);
+          std::this_thread::sleep_until(due);
+        }
+      }
+    }
+    );
+  }
+
+  const auto begin = DefaultClock::now();
+  const auto end = begin + options.duration;
+  std::size_t peakRss = residentBytes();
+  auto nextReport = begin + options.report;
+  while (DefaultClock::now() < end)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    peakRss = std::max(peakRss, residentBytes());
+    if (DefaultClock::now() >= nextReport)
+    {
+      nextReport += options.report;
+      const auto backlog = sink->getBacklog();
+      std::cout << std::chrono::duration_cast< std::chrono::seconds >(DefaultClock::now() - begin).count() << " s:"
+        << " queued " << backlog.messages << ", lag " << toMilliseconds(backlog.lag) << " ms"
+        << ", shed " << soakLogger->getShedCount() << ", rss " << residentBytes() / (1024 * 1024) << " MB" << std::endl;
+    }
+  }
+
+  stop = true;
+  for (auto& producer : producers)
+  {
+    producer.join();
+  }
+
+  // everything still queued is delivered, then the registry lets the logger go
+  registry()->disableOverloadControl(); // restores the logger
+  registry()->unregisterLogger(soakLogger->getName());
+  const auto drainLost = sink->drain(DefaultClock::now() + std::chrono::minutes(10));
+  peakRss = std::max(peakRss, residentBytes());
+  registry().unregisterHandle();
+  verifier.finish();
+
+  std::uint64_t totalSent = 0;
+  LatencyHistogram latency;
+  for (unsigned int producer = 0; producer < options.threads; ++producer)
+  {
+    totalSent += sent[producer];
+    latency.merge(latencies[producer]);
+  }
+  const auto shed = soakLogger->getShedCount();
+  const auto missing = verifier.missing(sent);
+  const auto explained = shed + faultSink->getLost() + drainLost;
+
+  std::cout << "sent " << totalSent << ", delivered " << verifier.getDelivered() << ", shed " << shed
+    << ", lost in failed writes " << faultSink->getLost() << ", not drained " << drainLost << std::endl;
+  std::cout << "writes " << faultSink->getWrites() << ": " << faultSink->getNoSpaceErrors() << " ENOSPC, "
+    << faultSink->getIoErrors() << " EIO, " << faultSink->getPartialWrites() << " partial, "
+    << verifier.getTruncated() << " lines truncated, " << faultSink->getLostOthers() << " other lines lost" << std::endl;
+  std::cout << "log call latency (ns): p50 " << latency.percentile(50.) << ", p99 " << latency.percentile(99.)
+    << ", p99.9 " << latency.percentile(99.9) << ", p99.99 " << latency.percentile(99.99)
+    << ", max " << latency.getMaximum() << std::endl;
+  std::cout << "peak rss " << peakRss / (1024 * 1024) << " MB" << std::endl;
+
+  bool passed = true;
+  if (verifier.getDuplicates())
+  {
+    std::cout << "FAILED: " << verifier.getDuplicates() << " messages duplicated or out of order" << std::endl;
+    passed = false;
+  }
+  if (missing != explained)
+  {
+    std::cout << "FAILED: " << missing << " messages missing, " << explained << " shed or lost as reported" << std::endl;
+    passed = false;
+  }
+  if (peakRss > options.maxRssMb * 1024 * 1024)
+  {
+    std::cout << "FAILED: peak rss above " << options.maxRssMb << " MB" << std::endl;
+    passed = false;
+  }
+  return passed;
+}
+
+/* FileSink on a full disk: the errors reach the handler, logging goes on */
+bool soakFileErrors(const Options& options)
+{
+  std::cout << "--- file-full ---" << std::endl;
+
+  auto fileSink = std::make_shared< details::FileSink >("/dev/full",
+    [](const Message& message) { return message.content + "\n"; });
+  std::uint64_t reported = 0;
+  int lastError = 0;
+  fileSink->setErrorHandler([&](const std::string&, int error, std::uint64_t)
+  {
+    ++reported;
+    lastError = error;
+  }
+  );
+  auto sink = std::make_shared< details::MultithreadSink >(fileSink);
+
+  registry().registerHandle(std::make_unique< details::MultithreadRegistryHandle >());
+  auto fileLogger = std::make_shared< Logger >("soak.file-full");
+  fileLogger->setSink(sink);
+  fileLogger->setLevel(Level::INFO);
+  registry()->registerLogger(fileLogger);
+
+  const auto end = DefaultClock::now() + std::min< DefaultClock::duration >(options.duration, std::chrono::seconds(5));
+  std::uint64_t sent = 0;
+  while (DefaultClock::now() < end)
+  {
+    fileLogger->info(LOGGER_CALL_CONTEXT, "message " + std::to_string(sent++));
+    if (sent % 1024 == 0)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  registry()->unregisterLogger(fileLogger->getName());
+  sink->drain(DefaultClock::now() + std::chrono::minutes(1));
+  registry().unregisterHandle();
+
+  std::cout << "sent " << sent << ", write errors " << fileSink->getErrorCount() << ", reported " << reported
+    << " time(s), last: " << std::strerror(lastError) << std::endl;
+  if (!fileSink->getErrorCount() || !reported)
+  {
+    std::cout << "FAILED: write errors not reported" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  Options options;
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string argument = argv[i];
+    if (argument == "--no-overload-control")
+    {
+      options.overloadControl = false;
+      continue;
+    }
+    if (i + 1 >= argc)
+    {
+      std::cerr << "missing value of " << argument << std::endl;
+      return 1;
+    }
+
+    const std::string value = argv[++i];
+    if (argument == "--variant")
+    {
+      options.variant = value;
+    }
+    else if (argument == "--duration")
+    {
+      options.duration = std::chrono::seconds(std::stoll(value));
+    }
+    else if (argument == "--threads")
+    {
+      options.threads = static_cast< unsigned int >(std::stoul(value));
+    }
+    else if (argument == "--rate")
+    {
+      options.rate = std::stoull(value);
+    }
+    else if (argument == "--latency-us")
+    {
+      options.latency = std::chrono::microseconds(std::stoll(value));
+    }
+    else if (argument == "--throughput")
+    {
+      options.throughput = std::stoull(value);
+    }
+    else if (argument == "--fail-rate")
+    {
+      options.failRate = std::stod(value);
+    }
+    else if (argument == "--partial-rate")
+    {
+      options.partialRate = std::stod(value);
+    }
+    else if (argument == "--max-rss-mb")
+    {
+      options.maxRssMb = std::stoull(value);
+    }
+    else if (argument == "--report")
+    {
+      options.report = std::chrono::seconds(std::stoll(value));
+    }
+    else if (argument == "--seed")
+    {
+      options.seed = std::stoull(value);
+    }
+    else
+    {
+      std::cerr << "unknown option " << argument << std::endl;
+      return 1;
+    }
+  }
+
+  const auto all = variants();
+  if (options.variant != "all" && std::find(all.begin(), all.end(), options.variant) == all.end())
+  {
+    std::cerr << "unknown variant " << options.variant << std::endl;
+    return 1;
+  }
+
+  bool passed = true;
+  for (const auto& variant : all)
+  {
+    if (options.variant != "all" && options.variant != variant)
+    {
+      continue;
+    }
+    passed = (variant == "file-full" ? soakFileErrors(options) : soak(variant, options)) && passed;
+  }
+  std::cout << (passed ? "PASSED" : "FAILED") << std::endl;
+  return passed ? 0 : 1;
+}